@@ -1,51 +1,175 @@
+#define _POSIX_C_SOURCE 200809L // For read under -std=c11
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <pthread.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bloom_filter.h"  // From ../SharedMemoryHashing, see the makefile
+#include "profiler.h"
+#include "tokenizer.h"
+#include "djb2.h"
+#include "table_sizing.h"
 
 #define GLOBAL_HASH_TABLE_SIZE 16777216
-#define HASH_TABLE_SIZE (GLOBAL_HASH_TABLE_SIZE / NUM_PES)
+#define INITIAL_TABLE_LOG 10     // Per-PE tables start at 1024 slots and double as needed
+#define MAX_LOAD_PERCENT 70
 #define BATCH_SIZE 10000000 / NUM_PES
 #define MAX_STRING_LENGTH 50
-#define MAX_STRINGS_PER_PE (10000000 / NUM_PES)
+#define MAX_WORDS 10000000       // Word limit when reading the sample file
+#define STREAM_CHUNK_SIZE (1 << 20)
+#define TOKEN_DELIMITERS " ,.-\n"  // Same set as Tokenizer_scan
+#define TOKEN_BATCH 256              // Tokens scanned per Tokenizer_scan call
 #define NUM_PES 16 // Fixed number of partitions
+#define AGGREGATION_SLOTS 4096   // Direct-mapped combining cache per outbound batch
+#define HEAVY_KEY_THRESHOLD 1000 // Aggregated count inside one batch that marks a key heavy
+#define MAX_HEAVY_KEYS 64
+#define HEAVY_SLOTS 128          // Open-addressing index over heavyKeys, power of two
+#define DEFAULT_BLOOM_RATE 0.01
+#define MAIN_WORKER NUM_PES      // Profiler row of the main thread, owners use their PE
 
+// One slot is exactly one cache line with the key stored inline
 typedef struct {
     char key[MAX_STRING_LENGTH];
-    int value;
-    struct HashEntry* next;
-} HashEntry;
+    unsigned int hash;     // Cached full hash, reused for probing and resizing
+    long long value;
+} Slot;
+_Static_assert(sizeof(Slot) == 64, "Slot must fill one cache line");
+
+// Bloom filter over one PE's keys, the shared-memory driver's split-block
+// filter. Query threads read it without the owner, so one replaced by a
+// resize stays on the previous list and is freed with the table.
+typedef struct PEFilter {
+    BloomFilter* bloom;        // NULL if it could not be allocated: lookups ask the owner
+    struct PEFilter* previous;
+} PEFilter;
 
+// Open-addressing table of one PE. Only that PE's owner thread ever touches
+// it, so it needs no locks; PELocks only guard the mailbox in front of it.
+// The filter is the exception: query threads read it to skip absent keys.
 typedef struct {
-    HashEntry** table;
-    int size;
-    pthread_mutex_t lock;
+    Slot* slots;
+    int logSize;
+    size_t count;
+    PEFilter* filter;      // NULL unless --bloom
 } HashTable;
 
 typedef struct {
     char key[MAX_STRING_LENGTH];
-    int value;
+    unsigned int hash;
+    long long value;
 } Operation;
 
 typedef struct {
     Operation* operations; // Array of operations
     int count;
+    int* combine;          // Op index per aggregation slot, -1 if unused
 } Batch;
 
+// Keys hot enough that their home PE would straggle; their operations are
+// spread round-robin over all PEs and merged again at query time.
+typedef struct {
+    char key[MAX_STRING_LENGTH];
+    int hash;
+    int nextPE;
+} HeavyKey;
+
+// Countdown a caller blocks on until every PE has handled its request
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int remaining;
+} Completion;
+
+// One key of a batched query and where its answer goes
+typedef struct {
+    const char* key;
+    int index;
+} Lookup;
+
+// All lookups of one query batch owned by a single PE
+typedef struct QueryGroup {
+    int PE;
+    Lookup* lookups;
+    int count;
+    int erase;             // Remove the keys, results get the values they had
+    long long* results;    // Caller's output array, in input order
+    Completion* completion;
+    struct QueryGroup* next;
+} QueryGroup;
+
+// How a merged value combines with the one already stored
+typedef enum {
+    COMBINE_ADD,
+    COMBINE_MAX,
+    COMBINE_REPLACE
+} CombinePolicy;
+
+// Request for an owner to apply its pending batch. Requests queue up in the
+// mailbox, so concurrent flushes are all answered by one pass over the batch.
+typedef struct FlushRequest {
+    Completion* completion;
+    struct FlushRequest* next;
+} FlushRequest;
+
+// Request for an owner to merge another table into its partition
+typedef struct MergeRequest {
+    const HashTable* source;
+    CombinePolicy policy;
+    Completion* completion;
+    struct MergeRequest* next;
+} MergeRequest;
+
+// Chunked reader for --stream, one chunk plus a carried partial token
+typedef struct {
+    int fd;
+    char* buffer;       // STREAM_CHUNK_SIZE + 1 bytes
+    size_t tail;        // Start of the partial token carried into the next chunk
+    size_t tailLength;
+    int eof;
+} StreamReader;
+
+typedef struct {
+    long long tokensRouted;   // Tokens sent to this PE before aggregation
+    long long operations;     // Operations actually applied by processBatch
+    double busySeconds;       // Time spent inside processBatch
+    long long lookupsSkipped; // Lookups the filter answered without asking the owner
+} PEStats;
+
 HashTable hashTables[NUM_PES];
 Batch localBatches[NUM_PES];
 pthread_mutex_t PELocks[NUM_PES];
-char*** stringLists;
-int* stringCounts;
+pthread_cond_t PEWake[NUM_PES];
+pthread_t ownerThreads[NUM_PES];
+int PEids[NUM_PES];
+Batch ownerBatches[NUM_PES];          // Batch being applied by the owner, swapped with localBatches
+FlushRequest* pendingFlush[NUM_PES];  // Set when the owner should apply its batch
+MergeRequest* pendingMerge[NUM_PES];  // Newest first, applied in posting order
+QueryGroup* pendingQueries[NUM_PES];
+int shuttingDown[NUM_PES];           // Set under the PE lock to stop its owner
+HeavyKey heavyKeys[MAX_HEAVY_KEYS];
+int heavySlots[HEAVY_SLOTS]; // Index + 1 into heavyKeys, 0 if empty
+int heavyCount = 0;
+PEStats peStats[NUM_PES];
+double bloomRate = 0.0;      // Target false-positive rate of the PE filters, 0 for none
+int initialTableLog = INITIAL_TABLE_LOG; // Per-PE starting size, picked by --auto-size
+
+// Hash function, the shared DJB2 so it agrees with the hashes of Tokenizer_scan
+unsigned long hashString(const char* str) {
+    return Djb2_hash(str);
+}
 
-// Hash function
 int hash(const char* str, int size) {
-    unsigned long hash = 5381;
-    for (int i = 0; str[i] != '\0'; i++) {
-        hash = ((hash << 5) + hash) + str[i];
-    }
-    return abs((int)(hash % size));
+    return abs((int)(hashString(str) % size));
+}
+
+// Slot index from the high bits, the low bits are shared by all keys of a PE
+size_t slotIndex(unsigned int h, int logSize) {
+    return (size_t)((h * 2654435769u) >> (32 - logSize));
 }
 
 // Responsible Partition
@@ -53,166 +177,854 @@ int responsiblePE(int index) {
     return index % NUM_PES;
 }
 
-// Insert into hash table
-void hashTableInsert(HashTable* ht, const char* key, int value) {
-    int idx = hash(key, ht->size);
-    HashEntry* current = ht->table[idx];
+// Look up a heavy key, returns its index or -1
+int findHeavyKey(const char* key, int h) {
+    for (int i = 0; i < HEAVY_SLOTS; i++) {
+        int slot = __atomic_load_n(&heavySlots[(h + i) & (HEAVY_SLOTS - 1)], __ATOMIC_ACQUIRE);
+        if (slot == 0) return -1;
+        if (heavyKeys[slot - 1].hash == h && strcmp(heavyKeys[slot - 1].key, key) == 0) return slot - 1;
+    }
+    return -1;
+}
+
+// Register a heavy key; only the ingest thread calls this, queries may read concurrently
+void markHeavyKey(const char* key, int h) {
+    if (heavyCount >= MAX_HEAVY_KEYS || findHeavyKey(key, h) >= 0) return;
+
+    HeavyKey* hk = &heavyKeys[heavyCount];
+    strncpy(hk->key, key, MAX_STRING_LENGTH);
+    hk->key[MAX_STRING_LENGTH - 1] = '\0';
+    hk->hash = h;
+    hk->nextPE = responsiblePE(h);
 
-    while (current != NULL) {
-        if (strcmp(current->key, key) == 0) {
-            current->value += value;
+    int i = h & (HEAVY_SLOTS - 1);
+    while (heavySlots[i] != 0) i = (i + 1) & (HEAVY_SLOTS - 1);
+    __atomic_store_n(&heavySlots[i], ++heavyCount, __ATOMIC_RELEASE); // Publish after the key is written
+}
+
+// Route a token: normal keys go to their home PE, heavy keys are split over all PEs
+int routeToken(const char* key, int h) {
+    int heavy = heavyCount ? findHeavyKey(key, h) : -1;
+    if (heavy < 0) return responsiblePE(h);
+    int PE = heavyKeys[heavy].nextPE;
+    heavyKeys[heavy].nextPE = (PE + 1) % NUM_PES;
+    return PE;
+}
+
+void bloomFree(PEFilter* filter) {
+    while (filter) {
+        PEFilter* previous = filter->previous;
+        if (filter->bloom) BloomFilter_free(filter->bloom);
+        free(filter);
+        filter = previous;
+    }
+}
+
+// Only the owner adds; query threads may be testing the same words.
+// A missing filter, like one without bits, holds nothing and rules out nothing.
+void bloomAdd(PEFilter* filter, unsigned int h) {
+    if (filter && filter->bloom) BloomFilter_add(filter->bloom, h);
+}
+
+int bloomMayContain(const PEFilter* filter, unsigned int h) {
+    return !filter || !filter->bloom || BloomFilter_mayContain(filter->bloom, h);
+}
+
+// Filter for a table of 2^logSize slots filled up to the load limit, NULL if
+// even the PEFilter could not be allocated: that PE's lookups ask the owner
+PEFilter* bloomForTable(int logSize) {
+    PEFilter* filter = malloc(sizeof(PEFilter));
+    if (!filter) return NULL;
+    filter->bloom = BloomFilter_init(((size_t)1 << logSize) * MAX_LOAD_PERCENT / 100, bloomRate);
+    filter->previous = NULL;
+    return filter;
+}
+
+// Create an empty table, an empty key marks a free slot. Slots are aligned
+// so each one really occupies a single cache line.
+void hashTableInit(HashTable* ht, int logSize) {
+    ht->slots = aligned_alloc(64, sizeof(Slot) << logSize);
+    memset(ht->slots, 0, sizeof(Slot) << logSize);
+    ht->logSize = logSize;
+    ht->count = 0;
+    ht->filter = NULL;
+}
+
+// Double the table, moving slots by their cached hash. A filter is rebuilt
+// for the new capacity and published whole; query threads may still hold the
+// old one, so it is kept on the previous list rather than freed.
+void hashTableGrow(HashTable* ht) {
+    HashTable bigger;
+    hashTableInit(&bigger, ht->logSize + 1);
+    size_t mask = ((size_t)1 << bigger.logSize) - 1;
+    PEFilter* filter = ht->filter ? bloomForTable(bigger.logSize) : NULL; // NULL keeps the old one, still correct
+
+    for (size_t i = 0; i < ((size_t)1 << ht->logSize); i++) {
+        if (ht->slots[i].key[0] == '\0') continue;
+        size_t idx = slotIndex(ht->slots[i].hash, bigger.logSize);
+        while (bigger.slots[idx].key[0] != '\0') idx = (idx + 1) & mask;
+        bigger.slots[idx] = ht->slots[i];
+        if (filter) bloomAdd(filter, ht->slots[i].hash);
+    }
+    free(ht->slots);
+    ht->slots = bigger.slots;
+    ht->logSize = bigger.logSize;
+    if (filter) {
+        filter->previous = ht->filter;
+        __atomic_store_n(&ht->filter, filter, __ATOMIC_RELEASE);
+    }
+}
+
+// Insert into hash table, combining with an existing value according to policy
+void hashTableUpsert(HashTable* ht, const char* key, unsigned int h, long long value, CombinePolicy policy) {
+    size_t mask = ((size_t)1 << ht->logSize) - 1;
+    size_t idx = slotIndex(h, ht->logSize);
+
+    while (ht->slots[idx].key[0] != '\0') {
+        if (ht->slots[idx].hash == h && strcmp(ht->slots[idx].key, key) == 0) {
+            long long* stored = &ht->slots[idx].value;
+            switch (policy) {
+                case COMBINE_ADD: *stored += value; break;
+                case COMBINE_MAX: if (value > *stored) *stored = value; break;
+                case COMBINE_REPLACE: *stored = value; break;
+            }
             return;
         }
-        current = current->next;
+        idx = (idx + 1) & mask;
+    }
+
+    if ((ht->count + 1) * 100 > (mask + 1) * MAX_LOAD_PERCENT) {
+        hashTableGrow(ht);
+        hashTableUpsert(ht, key, h, value, policy);
+        return;
     }
 
-    HashEntry* newEntry = malloc(sizeof(HashEntry));
-    strncpy(newEntry->key, key, MAX_STRING_LENGTH);
-    newEntry->key[MAX_STRING_LENGTH - 1] = '\0';
-    newEntry->value = value;
-    newEntry->next = ht->table[idx];
-    ht->table[idx] = newEntry;
+    Slot* slot = &ht->slots[idx];
+    strncpy(slot->key, key, MAX_STRING_LENGTH);
+    slot->key[MAX_STRING_LENGTH - 1] = '\0';
+    slot->hash = h;
+    slot->value = value;
+    ht->count++;
+    if (ht->filter) bloomAdd(ht->filter, h);
+}
+
+void hashTableInsert(HashTable* ht, const char* key, unsigned int h, long long value) {
+    hashTableUpsert(ht, key, h, value, COMBINE_ADD);
+}
+
+// Merge src into dst with a straight scan of src's slots. The cached hashes
+// are reused, so no key is hashed again, and dst is grown once up front.
+void hashTableMerge(HashTable* dst, const HashTable* src, CombinePolicy policy) {
+    while ((dst->count + src->count) * 100 > ((size_t)1 << dst->logSize) * MAX_LOAD_PERCENT) {
+        hashTableGrow(dst);
+    }
+    for (size_t i = 0; i < ((size_t)1 << src->logSize); i++) {
+        const Slot* slot = &src->slots[i];
+        if (slot->key[0] != '\0') {
+            hashTableUpsert(dst, slot->key, slot->hash, slot->value, policy);
+        }
+    }
 }
 
 // Find in hash table
-int hashTableFind(HashTable* ht, const char* key) {
-    if (!ht || !ht->table) return 0;
+long long hashTableFind(HashTable* ht, const char* key) {
+    if (!ht || !ht->slots) return 0;
 
-    int idx = hash(key, ht->size);
-    HashEntry* current = ht->table[idx];
-    while (current != NULL) {
-        if (strcmp(current->key, key) == 0) return current->value;
-        current = current->next;
+    unsigned int h = (unsigned int)hashString(key);
+    size_t mask = ((size_t)1 << ht->logSize) - 1;
+    for (size_t idx = slotIndex(h, ht->logSize); ht->slots[idx].key[0] != '\0'; idx = (idx + 1) & mask) {
+        if (ht->slots[idx].hash == h && strcmp(ht->slots[idx].key, key) == 0) return ht->slots[idx].value;
     }
 
     return 0;
 }
 
+// Remove key, returning the value it had or 0 if absent. Probe runs have no
+// tombstones, so the slots after the hole that may move back are shifted into
+// it. The filter keeps the key's bits; a later lookup just asks the owner.
+long long hashTableErase(HashTable* ht, const char* key) {
+    if (!ht || !ht->slots) return 0;
+
+    unsigned int h = (unsigned int)hashString(key);
+    size_t mask = ((size_t)1 << ht->logSize) - 1;
+    size_t idx = slotIndex(h, ht->logSize);
+    while (ht->slots[idx].key[0] != '\0' && (ht->slots[idx].hash != h || strcmp(ht->slots[idx].key, key) != 0)) {
+        idx = (idx + 1) & mask;
+    }
+    if (ht->slots[idx].key[0] == '\0') return 0;
+    long long value = ht->slots[idx].value;
+
+    size_t hole = idx;
+    for (size_t next = (hole + 1) & mask; ht->slots[next].key[0] != '\0'; next = (next + 1) & mask) {
+        size_t home = slotIndex(ht->slots[next].hash, ht->logSize);
+        if (((next - home) & mask) >= ((next - hole) & mask)) { // Home is not past the hole
+            ht->slots[hole] = ht->slots[next];
+            hole = next;
+        }
+    }
+    ht->slots[hole].key[0] = '\0';
+    ht->count--;
+    return value;
+}
+
+void completionInit(Completion* c, int count) {
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->done, NULL);
+    c->remaining = count;
+}
+
+void completionSignal(Completion* c) {
+    pthread_mutex_lock(&c->lock);
+    if (--c->remaining == 0) pthread_cond_signal(&c->done);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Block until every participant signalled, then release the completion
+void completionWait(Completion* c) {
+    pthread_mutex_lock(&c->lock);
+    while (c->remaining > 0) pthread_cond_wait(&c->done, &c->lock);
+    pthread_mutex_unlock(&c->lock);
+    pthread_cond_destroy(&c->done);
+    pthread_mutex_destroy(&c->lock);
+}
+
+// Answer one PE's share of a query batch; runs on that PE's owner thread
+void answerQueryGroup(QueryGroup* group) {
+    HashTable* ht = &hashTables[group->PE];
+    for (int i = 0; i < group->count; i++) {
+        const char* key = group->lookups[i].key;
+        long long value = group->erase ? hashTableErase(ht, key) : hashTableFind(ht, key);
+        if (value != 0) {
+            // Heavy keys are answered by every PE, so partial results are added up
+            __sync_fetch_and_add(&group->results[group->lookups[i].index], value);
+        }
+    }
+    completionSignal(group->completion);
+}
+
+// Batched lookup: group keys by owning PE, let each PE answer its group in one
+// pass and gather the values back in input order. Safe to call while ingest
+// runs. With erase the owners also remove the keys they hold.
+void distributedLookupBatch(const char** keys, int count, long long* results, int erase) {
+    QueryGroup groups[NUM_PES];
+    Completion answered;
+    int* owners = malloc(count * sizeof(int)); // Owning PE per key, -1 for heavy keys, -2 if filtered out
+
+    for (int i = 0; i < NUM_PES; i++) {
+        groups[i].PE = i;
+        groups[i].count = 0;
+        groups[i].erase = erase;
+        groups[i].results = results;
+    }
+
+    // Count per PE first so every group is a single allocation. A key its
+    // owner's filter rules out is answered here without a mailbox round trip;
+    // heavy keys are spread over every PE and always asked.
+    for (int k = 0; k < count; k++) {
+        unsigned long fullHash = hashString(keys[k]);
+        int h = fullHash % GLOBAL_HASH_TABLE_SIZE;
+        owners[k] = findHeavyKey(keys[k], h) >= 0 ? -1 : responsiblePE(h);
+        results[k] = 0;
+        if (owners[k] >= 0) {
+            const PEFilter* filter = __atomic_load_n(&hashTables[owners[k]].filter, __ATOMIC_ACQUIRE);
+            if (filter && !bloomMayContain(filter, (unsigned int)fullHash)) {
+                __atomic_fetch_add(&peStats[owners[k]].lookupsSkipped, 1, __ATOMIC_RELAXED);
+                owners[k] = -2;
+                continue;
+            }
+            groups[owners[k]].count++;
+        } else {
+            for (int i = 0; i < NUM_PES; i++) groups[i].count++;
+        }
+    }
+
+    for (int i = 0; i < NUM_PES; i++) {
+        groups[i].lookups = malloc((groups[i].count + 1) * sizeof(Lookup));
+        groups[i].count = 0;
+    }
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < NUM_PES; i++) {
+            if (owners[k] == i || owners[k] == -1) {
+                groups[i].lookups[groups[i].count++] = (Lookup){keys[k], k};
+            }
+        }
+    }
+
+    // Hand every non-empty group to its owner's mailbox and wait for all answers
+    int posted = 0;
+    for (int i = 0; i < NUM_PES; i++) {
+        if (groups[i].count > 0) posted++;
+    }
+    completionInit(&answered, posted);
+    for (int i = 0; i < NUM_PES; i++) {
+        if (groups[i].count == 0) continue;
+        groups[i].completion = &answered;
+        pthread_mutex_lock(&PELocks[i]);
+        groups[i].next = pendingQueries[i];
+        pendingQueries[i] = &groups[i];
+        pthread_cond_signal(&PEWake[i]);
+        pthread_mutex_unlock(&PELocks[i]);
+    }
+    completionWait(&answered);
+
+    for (int i = 0; i < NUM_PES; i++) {
+        free(groups[i].lookups);
+    }
+    free(owners);
+}
+
+void distributedFindBatch(const char** keys, int count, long long* results) {
+    distributedLookupBatch(keys, count, results, 0);
+}
+
+// Find across partitions: heavy keys are summed over every PE
+long long distributedFind(const char* key) {
+    long long value;
+    distributedFindBatch(&key, 1, &value);
+    return value;
+}
+
 // Allocate memory
 void allocateMemory() {
-    stringLists = malloc(NUM_PES * sizeof(char**));
-    stringCounts = malloc(NUM_PES * sizeof(int));
-
     for (int i = 0; i < NUM_PES; i++) {
-        hashTables[i].table = calloc(HASH_TABLE_SIZE, sizeof(HashEntry*));
-        hashTables[i].size = HASH_TABLE_SIZE;
+        hashTableInit(&hashTables[i], initialTableLog);
+        if (bloomRate > 0) hashTables[i].filter = bloomForTable(initialTableLog);
         pthread_mutex_init(&PELocks[i], NULL);
+        pthread_cond_init(&PEWake[i], NULL);
+        pendingFlush[i] = NULL;
+        pendingMerge[i] = NULL;
+        pendingQueries[i] = NULL;
+        shuttingDown[i] = 0;
 
-        localBatches[i].operations = malloc(BATCH_SIZE * sizeof(Operation));
-        localBatches[i].count = 0;
-
-        stringLists[i] = malloc(MAX_STRINGS_PER_PE * sizeof(char*));
-        for (int j = 0; j < MAX_STRINGS_PER_PE; j++) {
-            stringLists[i][j] = malloc((MAX_STRING_LENGTH + 1) * sizeof(char));
+        Batch* batches[2] = {&localBatches[i], &ownerBatches[i]};
+        for (int b = 0; b < 2; b++) {
+            batches[b]->operations = malloc(BATCH_SIZE * sizeof(Operation));
+            batches[b]->count = 0;
+            batches[b]->combine = malloc(AGGREGATION_SLOTS * sizeof(int));
+            for (int j = 0; j < AGGREGATION_SLOTS; j++) {
+                batches[b]->combine[j] = -1;
+            }
         }
-        stringCounts[i] = 0;
+        memset(&peStats[i], 0, sizeof(PEStats));
     }
 }
 
 // Free memory
 void freeMemory() {
     for (int i = 0; i < NUM_PES; i++) {
-        for (int j = 0; j < MAX_STRINGS_PER_PE; j++) {
-            free(stringLists[i][j]);
-        }
-        free(stringLists[i]);
-        free(hashTables[i].table);
+        free(hashTables[i].slots);
+        bloomFree(hashTables[i].filter);
         free(localBatches[i].operations);
+        free(localBatches[i].combine);
+        free(ownerBatches[i].operations);
+        free(ownerBatches[i].combine);
         pthread_mutex_destroy(&PELocks[i]);
+        pthread_cond_destroy(&PEWake[i]);
     }
-    free(stringLists);
-    free(stringCounts);
 }
 
-// Add operation to batch
-void addOperationToBatch(int partition, const char* key, int value) { // Add operation to batch
-    pthread_mutex_lock(&PELocks[partition]); // Lock the partition
-    if (localBatches[partition].count < BATCH_SIZE) { // If the batch is not full
-        Operation* op = &localBatches[partition].operations[localBatches[partition].count++]; 
+// Add operation to batch, combining it with a pending operation on the same key
+void addOperationToBatch(int partition, const char* key, long long value, unsigned long fullHash) { // Add operation to batch
+    int h = fullHash % GLOBAL_HASH_TABLE_SIZE;
+    pthread_mutex_lock(&PELocks[partition]); // Lock the partition's mailbox
+    Batch* batch = &localBatches[partition];
+    peStats[partition].tokensRouted++;
+
+    // Stale slots from an earlier pass are caught by the count and key checks
+    int* slot = &batch->combine[(h / NUM_PES) & (AGGREGATION_SLOTS - 1)];
+    if (*slot >= 0 && *slot < batch->count && strcmp(batch->operations[*slot].key, key) == 0) {
+        Operation* op = &batch->operations[*slot];
+        op->value += value;
+        if (op->value >= HEAVY_KEY_THRESHOLD) {
+            markHeavyKey(key, h);
+        }
+    } else if (batch->count < BATCH_SIZE) { // If the batch is not full
+        *slot = batch->count;
+        Operation* op = &batch->operations[batch->count++];
         strncpy(op->key, key, MAX_STRING_LENGTH);
         op->key[MAX_STRING_LENGTH - 1] = '\0';
+        op->hash = (unsigned int)fullHash;
         op->value = value;
     }
     pthread_mutex_unlock(&PELocks[partition]);
 }
 
-// Process Batch
-void* processBatch(void* arg) {
+// Process Batch: plain sequential inserts, the owner holds no lock here
+void processBatch(int PE, Batch* batch) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    Profiler_begin(PE, PHASE_INSERT);
+    for (int i = 0; i < batch->count; i++) {
+        Operation* op = &batch->operations[i];
+        hashTableInsert(&hashTables[PE], op->key, op->hash, op->value);
+    }
+    Profiler_end(PE, PHASE_INSERT);
+    peStats[PE].operations += batch->count;
+    batch->count = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    peStats[PE].busySeconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Owner thread of one PE: the only thread that ever reads or writes hashTables[PE].
+// It swaps the pending batch out under the mailbox lock and works on it unlocked.
+void* ownerLoop(void* arg) {
     int PE = *(int*)arg;
 
     pthread_mutex_lock(&PELocks[PE]);
-    for (int i = 0; i < localBatches[PE].count; i++) {
-        Operation* op = &localBatches[PE].operations[i];
-        hashTableInsert(&hashTables[PE], op->key, op->value);
+    while (1) {
+        while (!pendingFlush[PE] && !pendingMerge[PE] && !pendingQueries[PE] && !shuttingDown[PE]) {
+            pthread_cond_wait(&PEWake[PE], &PELocks[PE]);
+        }
+        FlushRequest* flush = pendingFlush[PE];
+        MergeRequest* merge = pendingMerge[PE];
+        QueryGroup* queries = pendingQueries[PE];
+        if (!flush && !merge && !queries) break; // Shutting down with nothing left to do
+
+        pendingFlush[PE] = NULL;
+        pendingMerge[PE] = NULL;
+        pendingQueries[PE] = NULL;
+        if (flush) {
+            Batch full = localBatches[PE];
+            localBatches[PE] = ownerBatches[PE];
+            ownerBatches[PE] = full;
+        }
+        pthread_mutex_unlock(&PELocks[PE]);
+
+        if (flush) {
+            processBatch(PE, &ownerBatches[PE]); // Covers every flush posted so far
+            while (flush) {
+                FlushRequest* next = flush->next; // The request is gone once signalled
+                completionSignal(flush->completion);
+                flush = next;
+            }
+        }
+
+        // Reverse the merges into posting order, so a later COMBINE_REPLACE wins
+        MergeRequest* ordered = NULL;
+        while (merge) {
+            MergeRequest* next = merge->next;
+            merge->next = ordered;
+            ordered = merge;
+            merge = next;
+        }
+        while (ordered) {
+            MergeRequest* next = ordered->next;
+            hashTableMerge(&hashTables[PE], ordered->source, ordered->policy);
+            completionSignal(ordered->completion);
+            ordered = next;
+        }
+        while (queries) {
+            QueryGroup* next = queries->next; // The group is gone once it is answered
+            answerQueryGroup(queries);
+            queries = next;
+        }
+
+        pthread_mutex_lock(&PELocks[PE]);
     }
-    localBatches[PE].count = 0;
     pthread_mutex_unlock(&PELocks[PE]);
 
+    Profiler_threadDone();
     return NULL;
 }
 
+void startOwners() {
+    for (int i = 0; i < NUM_PES; i++) {
+        PEids[i] = i;
+        pthread_create(&ownerThreads[i], NULL, ownerLoop, &PEids[i]);
+    }
+}
+
+void stopOwners() {
+    for (int i = 0; i < NUM_PES; i++) {
+        pthread_mutex_lock(&PELocks[i]);
+        shuttingDown[i] = 1;
+        pthread_cond_signal(&PEWake[i]);
+        pthread_mutex_unlock(&PELocks[i]);
+    }
+    for (int i = 0; i < NUM_PES; i++) {
+        pthread_join(ownerThreads[i], NULL);
+    }
+}
+
+// Merge a partitioned store (yesterday's snapshot, another ingest run) into
+// hashTables. sources[i] must hold the keys routed to PE i; every owner merges
+// its own partition in parallel. The sources must not change meanwhile.
+void mergePartitions(const HashTable* sources, CombinePolicy policy) {
+    Completion merged;
+    MergeRequest requests[NUM_PES];
+    completionInit(&merged, NUM_PES);
+    for (int i = 0; i < NUM_PES; i++) {
+        requests[i] = (MergeRequest){&sources[i], policy, &merged, NULL};
+        pthread_mutex_lock(&PELocks[i]);
+        requests[i].next = pendingMerge[i];
+        pendingMerge[i] = &requests[i];
+        pthread_cond_signal(&PEWake[i]);
+        pthread_mutex_unlock(&PELocks[i]);
+    }
+    completionWait(&merged);
+}
+
+// Load a dump written by dumpPartitions into one table per PE, each key at
+// its home PE (shares of a heavy key add up there), and merge them into
+// hashTables. Returns the number of keys loaded or -1 if the file cannot be read.
+long long mergeSnapshot(const char* path, CombinePolicy policy) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror("Could not open snapshot");
+        return -1;
+    }
+
+    HashTable sources[NUM_PES];
+    for (int i = 0; i < NUM_PES; i++) {
+        hashTableInit(&sources[i], INITIAL_TABLE_LOG);
+    }
+    char key[MAX_STRING_LENGTH];
+    long long value, loaded = 0;
+    while (fscanf(file, "%49s %lld", key, &value) == 2) {
+        unsigned long fullHash = hashString(key);
+        int PE = responsiblePE(fullHash % GLOBAL_HASH_TABLE_SIZE);
+        hashTableUpsert(&sources[PE], key, (unsigned int)fullHash, value, COMBINE_ADD);
+        loaded++;
+    }
+    fclose(file);
+
+    mergePartitions(sources, policy);
+    for (int i = 0; i < NUM_PES; i++) {
+        free(sources[i].slots);
+    }
+    return loaded;
+}
+
+// Write every partition as "key value" lines, the format mergeSnapshot reads.
+// The owners must be stopped. Returns 0 on success.
+int dumpPartitions(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror("Could not write snapshot");
+        return -1;
+    }
+    for (int i = 0; i < NUM_PES; i++) {
+        for (size_t s = 0; s < ((size_t)1 << hashTables[i].logSize); s++) {
+            const Slot* slot = &hashTables[i].slots[s];
+            if (slot->key[0] != '\0') fprintf(file, "%s %lld\n", slot->key, slot->value);
+        }
+    }
+    return fclose(file);
+}
+
+// Ask every owner to apply its pending batch and wait until all are done
+void flushPartitions() {
+    Completion flushed;
+    FlushRequest requests[NUM_PES];
+    completionInit(&flushed, NUM_PES);
+    for (int i = 0; i < NUM_PES; i++) {
+        requests[i].completion = &flushed;
+        pthread_mutex_lock(&PELocks[i]);
+        requests[i].next = pendingFlush[i];
+        pendingFlush[i] = &requests[i];
+        pthread_cond_signal(&PEWake[i]);
+        pthread_mutex_unlock(&PELocks[i]);
+    }
+    completionWait(&flushed);
+}
+
+// Erase keys from their owners, results get the counts they had (summed over
+// every PE for heavy keys). Pending batches are flushed first, so everything
+// routed before the call is erased; concurrent ingest may add a key back.
+void distributedEraseBatch(const char** keys, int count, long long* results) {
+    flushPartitions();
+    distributedLookupBatch(keys, count, results, 1);
+}
+
+// Print per-PE load so imbalance between partitions is visible
+void printPEStats() {
+    double maxBusy = 0, totalBusy = 0;
+    printf("PE  tokens      operations  busy(ms)\n");
+    for (int i = 0; i < NUM_PES; i++) {
+        printf("%-3d %-11lld %-11lld %.3f\n", i, peStats[i].tokensRouted, peStats[i].operations,
+               peStats[i].busySeconds * 1e3);
+        if (peStats[i].busySeconds > maxBusy) maxBusy = peStats[i].busySeconds;
+        totalBusy += peStats[i].busySeconds;
+    }
+    printf("Heavy keys: %d, busy max/mean: %.2f\n", heavyCount,
+           totalBusy > 0 ? maxBusy / (totalBusy / NUM_PES) : 0.0);
+
+    if (bloomRate > 0) {
+        printf("PE  filter(KB)  fp rate   lookups skipped (target fp rate %g)\n", bloomRate);
+        for (int i = 0; i < NUM_PES; i++) {
+            const PEFilter* filter = hashTables[i].filter;
+            const BloomFilter* bloom = filter ? filter->bloom : NULL;
+            if (!bloom) {
+                printf("%-3d none\n", i);
+                continue;
+            }
+            printf("%-3d %-11zu %-9.5f %lld\n", i, BloomFilter_bytes(bloom) / 1024,
+                   BloomFilter_falsePositiveRate(bloom), peStats[i].lookupsSkipped);
+        }
+    }
+}
+
+// Route one token to its partition's batch, fullHash as computed by Tokenizer_scan
+void ingestToken(const char* token, unsigned long fullHash) {
+    int partition = routeToken(token, fullHash % GLOBAL_HASH_TABLE_SIZE); // Determine partition
+    addOperationToBatch(partition, token, 1, fullHash); // Add operation to batch of the partition
+}
+
+// Split text with the shared tokenizer and route every token with the hash
+// it was scanned with; returns the number of tokens, at most maxTokens
+long long ingestText(char* text, size_t length, long long maxTokens) {
+    Token tokens[TOKEN_BATCH];
+    long long count = 0;
+    while (length > 0 && count < maxTokens) {
+        size_t consumed;
+        size_t wanted = maxTokens - count < TOKEN_BATCH ? (size_t)(maxTokens - count) : TOKEN_BATCH;
+        size_t scanned = Tokenizer_scan(text, length, tokens, wanted, &consumed);
+        for (size_t i = 0; i < scanned; i++) {
+            ingestToken(text + tokens[i].offset, tokens[i].hash);
+        }
+        count += scanned;
+        text += consumed;
+        length -= consumed;
+    }
+    return count;
+}
+
+StreamReader* streamOpen(const char* path) {
+    StreamReader* r = malloc(sizeof(StreamReader));
+    r->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    r->buffer = malloc(STREAM_CHUNK_SIZE + 1);
+    r->tail = 0;
+    r->tailLength = 0;
+    r->eof = 0;
+    if (r->fd < 0) {
+        perror("Could not open stream");
+        free(r->buffer);
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+void streamClose(StreamReader* r) {
+    if (r->fd != STDIN_FILENO) close(r->fd);
+    free(r->buffer);
+    free(r);
+}
+
+// Next NUL-terminated chunk cut at the last delimiter, NULL at end of input.
+// read() hands over what a pipe has, so lines are processed as they arrive.
+char* streamNext(StreamReader* r) {
+    memmove(r->buffer, r->buffer + r->tail, r->tailLength);
+    size_t filled = r->tailLength;
+    r->tail = 0;
+    r->tailLength = 0;
+
+    while (!r->eof && filled < STREAM_CHUNK_SIZE) {
+        ssize_t n = read(r->fd, r->buffer + filled, STREAM_CHUNK_SIZE - filled);
+        if (n <= 0) {
+            r->eof = 1;
+            break;
+        }
+        filled += n;
+        if (memchr(r->buffer + filled - n, '\n', n)) break; // A complete line arrived
+    }
+    if (filled == 0) return NULL;
+
+    size_t cut = filled;
+    if (!r->eof) {
+        while (cut > 0 && !strchr(TOKEN_DELIMITERS, r->buffer[cut - 1])) cut--;
+        if (cut == 0) cut = filled; // One token fills the whole chunk
+    }
+    r->tail = cut;
+    r->tailLength = filled - cut;
+    r->buffer[cut == filled ? filled : cut - 1] = '\0'; // Overwrites a delimiter, never the tail
+    return r->buffer;
+}
+
+// Streaming mode: ingest chunk by chunk and flush the batches after each one,
+// so memory is one chunk, the batches and the tables however long the input is
+long long streamIngest(const char* path) {
+    StreamReader* reader = streamOpen(path);
+    if (!reader) return -1;
+
+    long long totalWords = 0;
+    char* chunk;
+    while (1) {
+        Profiler_begin(MAIN_WORKER, PHASE_READ);
+        chunk = streamNext(reader);
+        Profiler_end(MAIN_WORKER, PHASE_READ);
+        if (!chunk) break;
+
+        Profiler_begin(MAIN_WORKER, PHASE_ROUTE);
+        totalWords += ingestText(chunk, strlen(chunk), LLONG_MAX);
+        Profiler_end(MAIN_WORKER, PHASE_ROUTE);
+        flushPartitions();
+    }
+
+    streamClose(reader);
+    return totalWords;
+}
+
+// --auto-size: start every PE table at its share of the table the distinct-key
+// estimate calls for, instead of at INITIAL_TABLE_LOG and doubling up to it.
+// The estimate's AUTO_TARGET_LOAD is below MAX_LOAD_PERCENT, which leaves room
+// for partitions that get more than their share; those still grow.
+void autoSizePartitions(const char* path) {
+    TableSizing sizing;
+    if (!TableSizing_fromFile(path, NUM_PES, &sizing)) {
+        printf("Auto-size needs a regular file to sample, using the default size\n");
+        return;
+    }
+    int logSize = (int)sizing.logSize;
+    for (int parts = 1; parts < NUM_PES && logSize > 1; parts *= 2) logSize--;
+    initialTableLog = logSize;
+    printf("Auto-size: ~%.0f distinct keys (%s), %d partitions of %zu slots\n", sizing.distinct,
+           sizing.sampled ? "scaled from a sample" : "counted", NUM_PES, (size_t)1 << initialTableLog);
+}
+
+// Write the per-phase profile to profilePath, or stderr when none was given
+void writeProfile(const char* profilePath) {
+    FILE* out = profilePath ? fopen(profilePath, "w") : stderr;
+    if (!out) {
+        perror("Could not open profile output");
+        return;
+    }
+    Profiler_report(out);
+    if (out != stderr) fclose(out);
+}
+
 // Main function
-int main() {
+// Usage: program                      read the sample file 10 times
+//        program --stream [file|-]    stream a file or stdin with bounded memory
+//        add --bloom [rate] to keep a Bloom filter per PE (default rate 0.01)
+//        that answers lookups of absent keys without asking the owner
+//        add --merge file (repeatable) to start from earlier runs' counts, added up,
+//        and --dump file to write the final counts in the same format
+//        add --erase key (repeatable) to remove keys once the input is ingested
+//        add --auto-size to start the PE tables at a size estimated from the input
+//        add --profile [file] for per-phase profiling as JSON lines (stderr by default):
+//        worker 0..NUM_PES-1 are the owners' inserts, worker NUM_PES the main thread
+int main(int argc, char** argv) {
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    pthread_t threads[NUM_PES];
-    int PEids[NUM_PES];
+    const char* streamPath = NULL;
+    const char* dumpPath = NULL;
+    const char* profilePath = NULL;
+    const char* filePath = "Lorem-ipsum-dolor-sit-amet.txt";
+    int autoSize = 0;
+    const char** mergePaths = malloc(argc * sizeof(char*));
+    const char** eraseKeys = malloc(argc * sizeof(char*));
+    int mergeCount = 0, eraseCount = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--merge") == 0 && i + 1 < argc) {
+            mergePaths[mergeCount++] = argv[++i];
+        } else if (strcmp(argv[i], "--erase") == 0 && i + 1 < argc) {
+            eraseKeys[eraseCount++] = argv[++i];
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dumpPath = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streamPath = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : "-";
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            Profiler_enable();
+            profilePath = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : NULL;
+        } else if (strcmp(argv[i], "--auto-size") == 0) {
+            autoSize = 1;
+        } else if (strcmp(argv[i], "--bloom") == 0) {
+            bloomRate = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? atof(argv[++i]) : DEFAULT_BLOOM_RATE;
+        }
+    }
 
+    if (autoSize) autoSizePartitions(streamPath ? streamPath : filePath);
     allocateMemory();
+    startOwners();
 
-    const char* filePath = "Lorem-ipsum-dolor-sit-amet.txt";
-    char line[4096];
-    int totalWords = 0;
+    for (int i = 0; i < mergeCount; i++) {  // In order, so a later snapshot lands after an earlier one
+        long long loaded = mergeSnapshot(mergePaths[i], COMBINE_ADD);
+        if (loaded < 0) {
+            stopOwners();
+            freeMemory();
+            free(mergePaths);
+            free(eraseKeys);
+            return 1;
+        }
+        printf("Merged %lld keys from %s\n", loaded, mergePaths[i]);
+    }
+    free(mergePaths);
 
-    for (int pass = 0; pass < 10; pass++) {  // Read the file 10 times
-        FILE* file = fopen(filePath, "r");
-        if (!file) {
-            perror("Could not open file");
+    if (streamPath) {
+        long long streamed = streamIngest(streamPath);
+        if (streamed < 0) {
+            stopOwners();
             freeMemory();
+            free(eraseKeys);
             return 1;
         }
+        printf("Total words streamed: %lld\n", streamed);
+    } else {
+        char line[4096];
+        int totalWords = 0;
 
-        while (fgets(line, sizeof(line), file)) {
-            char* token = strtok(line, " ,.-\n");
-            while (token != NULL && totalWords < 10000000) {
-                int partition = responsiblePE(hash(token, GLOBAL_HASH_TABLE_SIZE)); // Determine partition
-                addOperationToBatch(partition, token, 1); // Add operation to batch of the partition
-                totalWords++;
-                token = strtok(NULL, " ,.-\n");
+        for (int pass = 0; pass < 10; pass++) {  // Read the file 10 times
+            FILE* file = fopen(filePath, "r");
+            if (!file) {
+                perror("Could not open file");
+                stopOwners();
+                freeMemory();
+                free(eraseKeys);
+                return 1;
             }
-        }
-        fclose(file);
 
-        // Process partitions in parallel
-        for (int i = 0; i < NUM_PES; i++) {
-            PEids[i] = i;
-            pthread_create(&threads[i], NULL, processBatch, &PEids[i]);
-        }
+            // Reading and routing are interleaved per line here, both count as route
+            Profiler_begin(MAIN_WORKER, PHASE_ROUTE);
+            while (fgets(line, sizeof(line), file)) {
+                totalWords += ingestText(line, strlen(line), MAX_WORDS - totalWords);
+            }
+            Profiler_end(MAIN_WORKER, PHASE_ROUTE);
+            fclose(file);
 
-        for (int i = 0; i < NUM_PES; i++) {
-            pthread_join(threads[i], NULL);
-        }
+            // Process partitions in parallel
+            flushPartitions();
 
-        // Reset string counts
-        for (int i = 0; i < NUM_PES; i++) {
-            stringCounts[i] = 0;
+           // printf("Completed pass %d, total words: %d\n", pass + 1, totalWords);
         }
+    }
 
-       // printf("Completed pass %d, total words: %d\n", pass + 1, totalWords);
+    if (eraseCount > 0) {
+        long long* erased = malloc(eraseCount * sizeof(long long));
+        distributedEraseBatch(eraseKeys, eraseCount, erased);
+        for (int i = 0; i < eraseCount; i++) {
+            if (erased[i] > 0) {
+                printf("Erased %s (Value: %lld)\n", eraseKeys[i], erased[i]);
+            } else {
+                printf("Key %s not found\n", eraseKeys[i]);
+            }
+        }
+        free(erased);
     }
-    /*
+    free(eraseKeys);
+
     const char* keysToCheck[] = {"Lorem", "ipsum", "dolor", "sit", "amet"};
+    long long values[5];
+    distributedFindBatch(keysToCheck, 5, values);
     for (int i = 0; i < 5; i++) {
         const char* key = keysToCheck[i];
         int partition = responsiblePE(hash(key, GLOBAL_HASH_TABLE_SIZE));
-        int value = hashTableFind(&hashTables[partition], key);
 
-        printf("Key: %s, Value: %d (Stored in Partition %d)\n", key, value, partition);
+        printf("Key: %s, Value: %lld (Stored in Partition %d)\n", key, values[i], partition);
     }
-    */
 
+    stopOwners();
+    printPEStats();
+    if (dumpPath && dumpPartitions(dumpPath) != 0) {
+        fprintf(stderr, "Could not write %s\n", dumpPath);
+    }
+    Profiler_begin(MAIN_WORKER, PHASE_TEARDOWN);
     freeMemory();
+    Profiler_end(MAIN_WORKER, PHASE_TEARDOWN);
+    if (Profiler_enabled()) writeProfile(profilePath);
     clock_gettime(CLOCK_MONOTONIC, &end);
     double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
     printf("Program execution time: %.6f seconds\n", elapsed);
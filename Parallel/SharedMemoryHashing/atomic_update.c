@@ -38,3 +38,16 @@ bool atomicUpdateDecrement(MyElement *expected, const MyElement *desired, Decrem
         }
     }
 }
+
+bool atomicUpdateAdd(MyElement *expected, const MyElement *desired, Add f) {
+    (void)f;
+    while (true) {
+        // Capture the current value of data
+        long long oldData = expected->data;
+
+        // Attempt to add the desired value atomically
+        if (__sync_bool_compare_and_swap(&expected->data, oldData, oldData + desired->data)) {
+            return true;  // Addition succeeded
+        }
+    }
+}
@@ -15,8 +15,13 @@ typedef struct {
     int dummy; // Empty structure used as a type
 } Decrement;
 
+typedef struct {
+    int dummy; // Empty structure used as a type
+} Add;
+
 bool atomicUpdateOverwrite(MyElement *expected, const MyElement *desired, Overwrite f);
 bool atomicUpdateIncrement(MyElement *expected, const MyElement *desired, Increment f);
 bool atomicUpdateDecrement(MyElement *expected, const MyElement *desired, Decrement f);
+bool atomicUpdateAdd(MyElement *expected, const MyElement *desired, Add f);
 
 #endif // ATOMICUPDATE_H
@@ -0,0 +1,145 @@
+#include "bloom_filter.h"
+#include <math.h>
+#include <stdio.h>  // For error printing
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Odd multipliers, one per word; (key * salt) >> 27 picks the bit in that word
+static const uint32_t salts[BLOOM_BLOCK_WORDS] __attribute__((aligned(32))) = {
+    0x47B6137BU, 0x44974D91U, 0x8824AD5BU, 0xA2B7289DU, 0x705495C7U, 0x2DF1424BU, 0x9EFC4947U, 0x5C6BFB31U};
+
+// DJB2 is not random enough in its low bits to index blocks; finalise it
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static size_t blockIndex(const BloomFilter *bf, uint64_t h) {
+    return (size_t)(h >> 32) & (bf->numBlocks - 1);
+}
+
+// Expected false-positive rate with keysPerBlock keys per block on average.
+// Block loads are Poisson distributed; a block holding i keys answers yes for
+// an absent key with probability (1 - (31/32)^i)^8.
+static double expectedRate(double keysPerBlock) {
+    if (keysPerBlock > 64) {
+        return 1.0;  // Far too full; also keeps exp() from underflowing
+    }
+    double probability = exp(-keysPerBlock);
+    double rate = 0.0;
+    for (int i = 0; i < 256; ++i) {
+        rate += probability * pow(1.0 - pow(31.0 / 32.0, i), BLOOM_BLOCK_WORDS);
+        probability *= keysPerBlock / (i + 1);
+    }
+    return rate;
+}
+
+BloomFilter *BloomFilter_init(size_t expectedKeys, double falsePositiveRate) {
+    BloomFilter *bf = (BloomFilter *)malloc(sizeof(BloomFilter));
+    if (!bf) {
+        fprintf(stderr, "Memory allocation failed for BloomFilter.\n");
+        return NULL;
+    }
+
+    bf->numBlocks = 1;
+    while (bf->numBlocks < ((size_t)1 << 40) &&
+           expectedRate((double)expectedKeys / (double)bf->numBlocks) > falsePositiveRate) {
+        bf->numBlocks <<= 1;
+    }
+    bf->targetRate = falsePositiveRate;
+    bf->expectedKeys = expectedKeys;
+    // aligned_alloc wants a multiple of the alignment; one block is only half a line
+    size_t bytes = (bf->numBlocks * sizeof(BloomBlock) + 63) & ~(size_t)63;
+    bf->blocks = (BloomBlock *)aligned_alloc(64, bytes);
+    if (!bf->blocks) {
+        free(bf);
+        fprintf(stderr, "Memory allocation failed for BloomFilter blocks.\n");
+        return NULL;
+    }
+    memset(bf->blocks, 0, bytes);
+    return bf;
+}
+
+void BloomFilter_free(BloomFilter *bf) {
+    free(bf->blocks);
+    free(bf);
+}
+
+void BloomFilter_add(BloomFilter *bf, size_t hash) {
+    uint64_t h = mix64(hash);
+    BloomBlock *block = &bf->blocks[blockIndex(bf, h)];
+    uint32_t key = (uint32_t)h;
+
+    for (int w = 0; w < BLOOM_BLOCK_WORDS; ++w) {
+        uint32_t bit = 1U << ((key * salts[w]) >> 27);
+        // Read first: keys that are already present cost no write
+        if (!(__atomic_load_n(&block->words[w], __ATOMIC_RELAXED) & bit)) {
+            __atomic_fetch_or(&block->words[w], bit, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool BloomFilter_mayContain(const BloomFilter *bf, size_t hash) {
+    uint64_t h = mix64(hash);
+    const BloomBlock *block = &bf->blocks[blockIndex(bf, h)];
+    uint32_t key = (uint32_t)h;
+
+#if defined(__AVX2__)
+    __m256i positions = _mm256_srli_epi32(
+        _mm256_mullo_epi32(_mm256_set1_epi32((int)key), _mm256_load_si256((const __m256i *)salts)), 27);
+    __m256i bits = _mm256_sllv_epi32(_mm256_set1_epi32(1), positions);
+    return _mm256_testc_si256(_mm256_load_si256((const __m256i *)block->words), bits);
+#elif defined(__SSE2__)
+    // Four words at a time. SSE2 has neither a 32-bit lane multiply nor a
+    // variable shift: the products come from two 64-bit multiplies of the even
+    // and odd lanes, and 1 << position from a float with exponent position
+    // (2^31 converts to 0x80000000, which is the bit wanted).
+    __m128i keys = _mm_set1_epi32((int)key);
+    __m128i missing = _mm_setzero_si128();
+    for (int half = 0; half < 2; ++half) {
+        __m128i salt = _mm_load_si128((const __m128i *)salts + half);
+        __m128i even = _mm_mul_epu32(keys, salt);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(keys, 32), _mm_srli_epi64(salt, 32));
+        __m128i products = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        __m128i exponents = _mm_slli_epi32(_mm_add_epi32(_mm_srli_epi32(products, 27), _mm_set1_epi32(127)), 23);
+        __m128i bits = _mm_cvttps_epi32(_mm_castsi128_ps(exponents));
+        __m128i words = _mm_load_si128((const __m128i *)block->words + half);
+        missing = _mm_or_si128(missing, _mm_andnot_si128(words, bits));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(missing, _mm_setzero_si128())) == 0xFFFF;
+#else
+    uint32_t missing = 0;  // Branch-free so the compiler can vectorise it
+    for (int w = 0; w < BLOOM_BLOCK_WORDS; ++w) {
+        uint32_t bit = 1U << ((key * salts[w]) >> 27);
+        missing |= ~__atomic_load_n(&block->words[w], __ATOMIC_RELAXED) & bit;
+    }
+    return missing == 0;
+#endif
+}
+
+double BloomFilter_falsePositiveRate(const BloomFilter *bf) {
+    double sum = 0.0;
+    for (size_t b = 0; b < bf->numBlocks; ++b) {
+        double rate = 1.0;
+        for (int w = 0; w < BLOOM_BLOCK_WORDS; ++w) {
+            rate *= __builtin_popcount(__atomic_load_n(&bf->blocks[b].words[w], __ATOMIC_RELAXED)) / 32.0;
+        }
+        sum += rate;
+    }
+    return sum / (double)bf->numBlocks;
+}
+
+size_t BloomFilter_bytes(const BloomFilter *bf) {
+    return bf->numBlocks * sizeof(BloomBlock);
+}
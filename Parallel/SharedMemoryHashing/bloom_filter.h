@@ -0,0 +1,36 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Split-block Bloom filter: a key maps to one 32-byte block and sets one bit
+// in each of its eight 32-bit words, so a lookup reads half a cache line and
+// tests the eight bits with vector instructions: SSE2 by default on x86, one
+// AVX2 multiply, shift and test when built with make SIMD=avx2. Adds are thread
+// safe. DistributedMemoryHashing uses the same filter for its PEs.
+#define BLOOM_BLOCK_WORDS 8
+
+typedef struct {
+    uint32_t words[BLOOM_BLOCK_WORDS];
+} __attribute__((aligned(32))) BloomBlock;
+
+typedef struct {
+    BloomBlock *blocks;
+    size_t numBlocks;          // Power of two
+    double targetRate;         // False-positive rate the filter was sized for
+    size_t expectedKeys;
+} BloomFilter;
+
+// Smallest filter that stays at or below falsePositiveRate with expectedKeys keys
+BloomFilter *BloomFilter_init(size_t expectedKeys, double falsePositiveRate);
+void BloomFilter_free(BloomFilter *bf);
+// hash is Djb2_hash of the key, as hashtable.c and Tokenizer_scan compute it
+void BloomFilter_add(BloomFilter *bf, size_t hash);
+bool BloomFilter_mayContain(const BloomFilter *bf, size_t hash);
+// False-positive rate for a random absent key, from the bits set so far
+double BloomFilter_falsePositiveRate(const BloomFilter *bf);
+size_t BloomFilter_bytes(const BloomFilter *bf);
+
+#endif // BLOOMFILTER_H
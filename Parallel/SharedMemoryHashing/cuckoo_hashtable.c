@@ -0,0 +1,308 @@
+#include "cuckoo_hashtable.h"
+#include "djb2.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>  // For error printing
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpuRelax() __builtin_ia32_pause()
+#else
+#define cpuRelax() ((void)0)
+#endif
+
+typedef enum { UPDATE_OVERWRITE, UPDATE_INCREMENT, UPDATE_DECREMENT } UpdateKind;
+
+typedef struct {
+    size_t bucket;
+    int slot;
+} PathStep;
+
+// DJB2 leaves the low bits poorly mixed for similar keys; finalise it so
+// both the bucket index (low bits) and the tag (high bits) are uniform
+static uint64_t finalise(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t hash64(const char *str) {
+    return finalise(Djb2_hash(str));
+}
+
+static uint8_t tagOf(uint64_t h) {
+    uint8_t tag = (uint8_t)(h >> 56);
+    return tag ? tag : 1;  // 0 is reserved for empty slots
+}
+
+// Partial-key cuckoo: the alternate bucket only depends on the tag,
+// so displacement never has to rehash a stored key.
+static size_t altBucket(const CuckooHashTable *ht, size_t bucket, uint8_t tag) {
+    return (bucket ^ ((size_t)tag * 0x5BD1E995)) & ht->mask;
+}
+
+static uint32_t nextRandom(void) {
+    static __thread uint32_t state = 0;
+    if (state == 0) {
+        state = (uint32_t)(uintptr_t)&state | 1;  // Distinct seed per thread
+    }
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void lockBucket(CuckooBucket *b) {
+    while (true) {
+        uint32_t v = __atomic_load_n(&b->version, __ATOMIC_RELAXED);
+        if ((v & 1) == 0 &&
+            __atomic_compare_exchange_n(&b->version, &v, v + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        cpuRelax();
+    }
+}
+
+static void unlockBucket(CuckooBucket *b) {
+    __atomic_fetch_add(&b->version, 1, __ATOMIC_RELEASE);
+}
+
+// Always lock the lower index first so two writers cannot deadlock
+static void lockPair(CuckooHashTable *ht, size_t b1, size_t b2) {
+    if (b1 == b2) {
+        lockBucket(&ht->buckets[b1]);
+    } else if (b1 < b2) {
+        lockBucket(&ht->buckets[b1]);
+        lockBucket(&ht->buckets[b2]);
+    } else {
+        lockBucket(&ht->buckets[b2]);
+        lockBucket(&ht->buckets[b1]);
+    }
+}
+
+static void unlockPair(CuckooHashTable *ht, size_t b1, size_t b2) {
+    unlockBucket(&ht->buckets[b1]);
+    if (b1 != b2) {
+        unlockBucket(&ht->buckets[b2]);
+    }
+}
+
+static MyElement *findSlot(CuckooBucket *b, uint8_t tag, const char *key) {
+    for (int s = 0; s < CUCKOO_SLOTS_PER_BUCKET; ++s) {
+        if (b->tags[s] == tag && strncmp(b->slots[s].key, key, MAX_KEY_LENGTH) == 0) {
+            return &b->slots[s];
+        }
+    }
+    return NULL;
+}
+
+static int emptySlot(const CuckooBucket *b) {
+    for (int s = 0; s < CUCKOO_SLOTS_PER_BUCKET; ++s) {
+        if (b->tags[s] == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+CuckooHashTable *CuckooHashTable_init(size_t logSize) {
+    CuckooHashTable *ht = (CuckooHashTable *)malloc(sizeof(CuckooHashTable));
+    if (!ht) {
+        fprintf(stderr, "Memory allocation failed for CuckooHashTable.\n");
+        return NULL;
+    }
+
+    size_t numBuckets = (1ULL << logSize) / CUCKOO_SLOTS_PER_BUCKET;
+    if (numBuckets == 0) {
+        numBuckets = 1;
+    }
+    ht->mask = numBuckets - 1;
+    ht->size = numBuckets * CUCKOO_SLOTS_PER_BUCKET;
+    ht->buckets = (CuckooBucket *)aligned_alloc(64, numBuckets * sizeof(CuckooBucket));
+    if (!ht->buckets) {
+        free(ht);
+        fprintf(stderr, "Memory allocation failed for CuckooHashTable buckets.\n");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < numBuckets; i++) {
+        ht->buckets[i].version = 0;
+        for (int s = 0; s < CUCKOO_SLOTS_PER_BUCKET; ++s) {
+            ht->buckets[i].tags[s] = 0;
+            ht->buckets[i].slots[s] = MyElement_getEmptyValue();
+        }
+    }
+    return ht;
+}
+
+void CuckooHashTable_free(CuckooHashTable *ht) {
+    free(ht->buckets);
+    free(ht);
+}
+
+// Optimistic lookup: read both buckets without locking and retry if either
+// version moved, which also covers an element migrating between them.
+MyElement CuckooHashTable_find(CuckooHashTable *ht, const char *key) {
+    uint64_t h = hash64(key);
+    uint8_t tag = tagOf(h);
+    size_t i1 = h & ht->mask;
+    size_t i2 = altBucket(ht, i1, tag);
+    CuckooBucket *b1 = &ht->buckets[i1];
+    CuckooBucket *b2 = &ht->buckets[i2];
+
+    while (true) {
+        uint32_t v1 = __atomic_load_n(&b1->version, __ATOMIC_ACQUIRE);
+        uint32_t v2 = __atomic_load_n(&b2->version, __ATOMIC_ACQUIRE);
+        if ((v1 | v2) & 1) {
+            cpuRelax();
+            continue;  // A writer is inside one of the buckets
+        }
+
+        MyElement result = MyElement_getEmptyValue();
+        MyElement *slot = findSlot(b1, tag, key);
+        if (!slot) {
+            slot = findSlot(b2, tag, key);
+        }
+        if (slot) {
+            result = *slot;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&b1->version, __ATOMIC_RELAXED) == v1 &&
+            __atomic_load_n(&b2->version, __ATOMIC_RELAXED) == v2) {
+            return result;
+        }
+    }
+}
+
+// Random walk from a full bucket pair to a bucket with a free slot.
+// Returns the path length (last step is the free slot) or 0 on failure.
+static int searchPath(CuckooHashTable *ht, size_t i1, size_t i2, PathStep *path) {
+    size_t bucket = (nextRandom() & 1) ? i1 : i2;
+
+    for (int depth = 0; depth < CUCKOO_MAX_PATH; ++depth) {
+        CuckooBucket *b = &ht->buckets[bucket];
+        int freeSlot = -1;
+        for (int s = 0; s < CUCKOO_SLOTS_PER_BUCKET; ++s) {
+            if (__atomic_load_n(&b->tags[s], __ATOMIC_RELAXED) == 0) {
+                freeSlot = s;
+                break;
+            }
+        }
+        if (freeSlot >= 0) {
+            path[depth].bucket = bucket;
+            path[depth].slot = freeSlot;
+            return depth + 1;
+        }
+
+        int victim = nextRandom() % CUCKOO_SLOTS_PER_BUCKET;
+        path[depth].bucket = bucket;
+        path[depth].slot = victim;
+        bucket = altBucket(ht, bucket, __atomic_load_n(&b->tags[victim], __ATOMIC_RELAXED));
+    }
+    return 0;
+}
+
+// Move elements backwards along the path so the first step becomes free.
+// Each move locks only its source and destination bucket.
+static bool executePath(CuckooHashTable *ht, const PathStep *path, int length) {
+    for (int i = length - 1; i > 0; --i) {
+        size_t from = path[i - 1].bucket;
+        size_t to = path[i].bucket;
+        CuckooBucket *src = &ht->buckets[from];
+        CuckooBucket *dst = &ht->buckets[to];
+
+        lockPair(ht, from, to);
+        uint8_t tag = src->tags[path[i - 1].slot];
+        if (tag == 0 || dst->tags[path[i].slot] != 0 || altBucket(ht, from, tag) != to) {
+            unlockPair(ht, from, to);
+            return false;  // Someone else changed the path under us
+        }
+        dst->slots[path[i].slot] = src->slots[path[i - 1].slot];
+        dst->tags[path[i].slot] = tag;
+        src->tags[path[i - 1].slot] = 0;
+        src->slots[path[i - 1].slot] = MyElement_getEmptyValue();
+        unlockPair(ht, from, to);
+    }
+    return true;
+}
+
+static bool insertOrUpdate(CuckooHashTable *ht, const MyElement *e, uint64_t h, UpdateKind kind) {
+    uint8_t tag = tagOf(h);
+    size_t i1 = h & ht->mask;
+    size_t i2 = altBucket(ht, i1, tag);
+    PathStep path[CUCKOO_MAX_PATH];
+
+    for (int attempt = 0; attempt <= CUCKOO_MAX_RETRIES; ++attempt) {
+        lockPair(ht, i1, i2);
+
+        MyElement *slot = findSlot(&ht->buckets[i1], tag, e->key);
+        if (!slot) {
+            slot = findSlot(&ht->buckets[i2], tag, e->key);
+        }
+        if (slot) {
+            // Same semantics as the atomicUpdate* functions; the bucket lock
+            // already serialises writers so no CAS loop is needed here.
+            switch (kind) {
+                case UPDATE_OVERWRITE: slot->data = e->data; break;
+                case UPDATE_INCREMENT: slot->data++; break;
+                case UPDATE_DECREMENT: slot->data--; break;
+            }
+            unlockPair(ht, i1, i2);
+            return true;
+        }
+
+        size_t target = i1;
+        int s = emptySlot(&ht->buckets[i1]);
+        if (s < 0) {
+            target = i2;
+            s = emptySlot(&ht->buckets[i2]);
+        }
+        if (s >= 0) {
+            ht->buckets[target].slots[s] = *e;
+            ht->buckets[target].tags[s] = tag;
+            unlockPair(ht, i1, i2);
+            return true;
+        }
+        unlockPair(ht, i1, i2);
+
+        int length = searchPath(ht, i1, i2, path);
+        if (length == 0) {
+            return false;  // No free slot reachable: table is effectively full
+        }
+        executePath(ht, path, length);  // On interference simply retry
+    }
+
+    return false;
+}
+
+bool CuckooHashTable_insertOrUpdateOverwrite(CuckooHashTable *ht, const MyElement *e, Overwrite f) {
+    (void)f;
+    return insertOrUpdate(ht, e, hash64(e->key), UPDATE_OVERWRITE);
+}
+
+bool CuckooHashTable_insertOrUpdateIncrement(CuckooHashTable *ht, const MyElement *e, Increment f) {
+    (void)f;
+    return insertOrUpdate(ht, e, hash64(e->key), UPDATE_INCREMENT);
+}
+
+bool CuckooHashTable_insertOrUpdateIncrementHashed(CuckooHashTable *ht, const char *key, size_t hash, Increment f) {
+    (void)f;
+    MyElement e = MyElement_init(key, 1);
+    return insertOrUpdate(ht, &e, finalise(hash), UPDATE_INCREMENT);
+}
+
+bool CuckooHashTable_insertOrUpdateDecrement(CuckooHashTable *ht, const MyElement *e, Decrement f) {
+    (void)f;
+    return insertOrUpdate(ht, e, hash64(e->key), UPDATE_DECREMENT);
+}
+
+double CuckooHashTable_loadFactor(CuckooHashTable *ht) {
+    size_t used = 0;
+    for (size_t i = 0; i <= ht->mask; i++) {
+        for (int s = 0; s < CUCKOO_SLOTS_PER_BUCKET; ++s) {
+            used += ht->buckets[i].tags[s] != 0;
+        }
+    }
+    return (double)used / (double)ht->size;
+}
@@ -0,0 +1,37 @@
+#ifndef CUCKOOHASHTABLE_H
+#define CUCKOOHASHTABLE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "my_element.h"
+#include "atomic_update.h"
+
+#define CUCKOO_SLOTS_PER_BUCKET 4   // 2 choices x 4 slots: ~95% load before inserts fail
+#define CUCKOO_MAX_PATH 256         // Longest displacement path searched per insert
+#define CUCKOO_MAX_RETRIES 8        // Path executions retried when other threads interfere
+
+// One bucket: a seqlock version word and 8-bit tags share the first cache line,
+// so a lookup only touches the slot whose tag matches.
+typedef struct {
+    uint32_t version;                       // Odd while a writer holds the bucket
+    uint8_t tags[CUCKOO_SLOTS_PER_BUCKET];  // 0 marks an empty slot
+    MyElement slots[CUCKOO_SLOTS_PER_BUCKET];
+} __attribute__((aligned(64))) CuckooBucket;
+
+typedef struct {
+    CuckooBucket *buckets;
+    size_t mask;        // Bucket index mask
+    size_t size;        // Total number of slots
+} CuckooHashTable;
+
+CuckooHashTable *CuckooHashTable_init(size_t logSize);
+void CuckooHashTable_free(CuckooHashTable *ht);
+MyElement CuckooHashTable_find(CuckooHashTable *ht, const char *key);
+bool CuckooHashTable_insertOrUpdateOverwrite(CuckooHashTable *ht, const MyElement *e, Overwrite f);
+bool CuckooHashTable_insertOrUpdateIncrement(CuckooHashTable *ht, const MyElement *e, Increment f);
+bool CuckooHashTable_insertOrUpdateIncrementHashed(CuckooHashTable *ht, const char *key, size_t hash, Increment f);
+bool CuckooHashTable_insertOrUpdateDecrement(CuckooHashTable *ht, const MyElement *e, Decrement f);
+double CuckooHashTable_loadFactor(CuckooHashTable *ht);
+
+#endif // CUCKOOHASHTABLE_H
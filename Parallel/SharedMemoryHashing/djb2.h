@@ -0,0 +1,25 @@
+#ifndef DJB2_H
+#define DJB2_H
+
+#include <stddef.h>
+
+// The one DJB2 of this module. The tables, the sketch, the Bloom filter and
+// Tokenizer_scan must all give a key the same hash, or a key inserted on one
+// path is not found on another, so every one of them hashes through here.
+// Bytes are read as signed char on every platform: keys with bytes >= 0x80
+// (UTF-8 text) hash differently as unsigned char.
+#define DJB2_SEED 5381
+
+static inline size_t Djb2_step(size_t hash, char c) {
+    return ((hash << 5) + hash) + (signed char)c;  // hash * 33 + c
+}
+
+static inline size_t Djb2_hash(const char *str) {
+    size_t hash = DJB2_SEED;
+    while (*str) {
+        hash = Djb2_step(hash, *str++);
+    }
+    return hash;
+}
+
+#endif // DJB2_H
@@ -3,24 +3,31 @@
 #include <string.h>
 #include <stdio.h>  // For error printing
 #include "atomic_update.h"
+#include "djb2.h"
 
 // If LONG_LONG_MAX is not available, define it manually
 #ifndef LONG_LONG_MAX
 #define LONG_LONG_MAX 9223372036854775807LL
 #endif
 
-static size_t hash(const char *str, size_t mask) {
-    size_t hash = 5381;  // Start with a large prime
-    int c;
+static size_t fullHash(const char *str) {
+    return Djb2_hash(str);
+}
 
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c;  // hash * 33 + c
+// Home slot of a key being inserted; also records the key in the filter
+static size_t homeSlotForInsert(HashTable *ht, const char *str) {
+    size_t full = fullHash(str);
+    if (ht->filter) {
+        BloomFilter_add(ht->filter, full);
     }
-
-    return hash & mask;  // Apply the mask to fit within table size
+    return full & ht->mask;  // Apply the mask to fit within table size
 }
 
 
+const char *HashTable_coreName(void) {
+    return "c";
+}
+
 HashTable *HashTable_init(size_t logSize) {
     HashTable *ht = (HashTable *)malloc(sizeof(HashTable));
     if (!ht) {
@@ -30,6 +37,7 @@ HashTable *HashTable_init(size_t logSize) {
 
     ht->size = (1ULL << logSize) - 1;
     ht->mask = ht->size;
+    ht->filter = NULL;
     ht->table = (MyElement *)aligned_alloc(16, (ht->size + 1) * sizeof(MyElement));  // Use aligned_alloc
     if (!ht->table) {
         free(ht);
@@ -45,73 +53,154 @@ HashTable *HashTable_init(size_t logSize) {
 
 
 void HashTable_free(HashTable *ht) {
+    if (ht->filter) {
+        BloomFilter_free(ht->filter);
+    }
     free(ht->table); 
     free(ht);
 }
 
 
 MyElement HashTable_find(HashTable *ht, const char *key) {
-    size_t h = hash(key, ht->mask);  // Use the updated hash function
+    size_t full = fullHash(key);
+    if (ht->filter && !BloomFilter_mayContain(ht->filter, full)) {
+        return MyElement_getEmptyValue();  // Definitely absent, the table is not touched
+    }
+    size_t h = full & ht->mask;
     for (size_t i = h; i < h + MAX_DIST; ++i) {
         MyElement *current = &ht->table[i & ht->mask];
 
-        if (strcmp(current->key, key) == 0) {  // Compare strings
-            return *current;  // Found the key
+        if (MyElement_isFree(current)) {
+            break;  // Empty slot means the key isn't present
         }
 
-        if (MyElement_isEmpty(current)) {
-            break;  // Empty slot means the key isn't present
+        if (strcmp(current->key, key) == 0) {  // Compare strings
+            return *current;  // Found the key
         }
     }
     return MyElement_getEmptyValue();  // Return empty if not found
 }
 
 bool HashTable_insertOrUpdateIncrement(HashTable *ht, const MyElement *e, Increment f) {
-    size_t h = hash(e->key, ht->mask);
+    size_t h = homeSlotForInsert(ht, e->key);
 
     // Iteratively retry until success or table is full
     for (size_t i = h; i < h + MAX_DIST; ++i) {
         MyElement *current = &ht->table[i & ht->mask];
 
-        // If the key matches, increment the count atomically
-        if (strcmp(current->key, e->key) == 0) {
-            return atomicUpdateIncrement(current, e, f);
-        }
-
-        // If the slot is empty, try to insert atomically
-        if (MyElement_isEmpty(current)) {
-            if (MyElement_CAS(current, e)) {
+        // If the slot is empty, try to claim it for the key. The key is only
+        // compared once no claim is in progress, so two inserts of the same
+        // key cannot both miss it and take two slots.
+        if (MyElement_isFree(current)) {
+            if (MyElement_claim(current, e)) {
                 return true;  // Successfully inserted
             } else {
-                // CAS failed; retry the current index
+                // Claim lost; the winner may have inserted this key
                 i--;  // Decrement `i` to retry this slot
                 continue;
             }
         }
+
+        // If the key matches, increment the count atomically
+        if (strcmp(current->key, e->key) == 0) {
+            return atomicUpdateIncrement(current, e, f);
+        }
     }
 
     return false;  // Table is full or max probing distance exceeded
 }
 
 
+bool HashTable_insertOrUpdateIncrementHashed(HashTable *ht, const char *key, size_t hash, Increment f) {
+    if (ht->filter) {
+        BloomFilter_add(ht->filter, hash);
+    }
+    size_t h = hash & ht->mask;
+    MyElement e;
+    bool built = false;  // Build the element only when the key has to be inserted
+
+    for (size_t i = h; i < h + MAX_DIST; ++i) {
+        MyElement *current = &ht->table[i & ht->mask];
+
+        if (MyElement_isFree(current)) {
+            if (!built) {
+                e = MyElement_init(key, 1);
+                built = true;
+            }
+            if (MyElement_claim(current, &e)) {
+                return true;
+            }
+            i--;  // Claim lost; retry the current index
+            continue;
+        }
+
+        if (strcmp(current->key, key) == 0) {
+            return atomicUpdateIncrement(current, &e, f);  // Does not read e
+        }
+    }
+    return false;  // Table is full or max probing distance exceeded
+}
 
 bool HashTable_insertOrUpdateDecrement(HashTable *ht, const MyElement *e, Decrement f) {
-    size_t h = hash(e->key, ht->mask);
+    size_t h = homeSlotForInsert(ht, e->key);
     for (size_t i = h; i < h + MAX_DIST; ++i) {
         MyElement *current = &ht->table[i & ht->mask];
 
+        if (MyElement_isFree(current)) {
+            // Try to claim the slot for the key
+            if (MyElement_claim(current, e)) {
+                return true;
+            }
+            i--;  // Claim lost; retry the current index
+            continue;
+        }
+
         if (strcmp(current->key, e->key) == 0) {
             // Increment the count atomically
             atomicUpdateDecrement(current, e, f);
             return true;
         }
+    }
+    return false;  // Table is full or max probing distance exceeded
+}
+
+
+bool HashTable_insertOrUpdateAdd(HashTable *ht, const MyElement *e, Add f) {
+    size_t h = homeSlotForInsert(ht, e->key);
+    for (size_t i = h; i < h + MAX_DIST; ++i) {
+        MyElement *current = &ht->table[i & ht->mask];
+
+        if (MyElement_isFree(current)) {
+            if (MyElement_claim(current, e)) {
+                return true;
+            }
+            i--;  // Claim lost; retry the current index
+            continue;
+        }
+
+        if (strcmp(current->key, e->key) == 0) {
+            return atomicUpdateAdd(current, e, f);
+        }
+    }
+    return false;  // Table is full or max probing distance exceeded
+}
+
+bool HashTable_insertOrUpdateOverwrite(HashTable *ht, const MyElement *e, Overwrite f) {
+    size_t h = homeSlotForInsert(ht, e->key);
+    for (size_t i = h; i < h + MAX_DIST; ++i) {
+        MyElement *current = &ht->table[i & ht->mask];
 
-        if (MyElement_isEmpty(current)) {
-            // Try to atomically insert using CAS
-            if (MyElement_CAS(current, e)) {
+        if (MyElement_isFree(current)) {
+            if (MyElement_claim(current, e)) {
                 return true;
             }
+            i--;  // Claim lost; retry the current index
+            continue;
+        }
+
+        if (strcmp(current->key, e->key) == 0) {
+            return atomicUpdateOverwrite(current, e, f);
         }
     }
     return false;  // Table is full or max probing distance exceeded
-}
\ No newline at end of file
+}
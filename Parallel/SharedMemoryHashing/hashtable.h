@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include "my_element.h"
 #include "atomic_update.h"
+#include "bloom_filter.h"
 
 #define MAX_DIST 100
 
@@ -12,12 +13,25 @@ typedef struct {
     MyElement *table;
     size_t mask;
     size_t size;
+    BloomFilter *filter;  // Optional, NULL unless HashTable_enableFilter was called
 } HashTable;
 
+// Table core this build links, "c" or "cpp" (make CORE=...)
+const char *HashTable_coreName(void);
 HashTable *HashTable_init(size_t logSize);
 void HashTable_free(HashTable *ht);
 MyElement HashTable_find(HashTable *ht, const char *key);
 bool HashTable_insertOrUpdateIncrement(HashTable *ht, const MyElement *e, Increment f);
-bool hashTable_insertOrUpdateDecrement(HashTable *ht, const MyElement *e, Decrement f);
+// Same as HashTable_insertOrUpdateIncrement for a key whose DJB2 hash was
+// already computed (Tokenizer_scan); the key is only copied if it is new
+bool HashTable_insertOrUpdateIncrementHashed(HashTable *ht, const char *key, size_t hash, Increment f);
+bool HashTable_insertOrUpdateDecrement(HashTable *ht, const MyElement *e, Decrement f);
+bool HashTable_insertOrUpdateAdd(HashTable *ht, const MyElement *e, Add f);
+bool HashTable_insertOrUpdateOverwrite(HashTable *ht, const MyElement *e, Overwrite f);
+// Check a Bloom filter before probing, so most lookups of absent keys touch
+// one filter block instead of the table. Call before the first insert.
+bool HashTable_enableFilter(HashTable *ht, size_t expectedKeys, double falsePositiveRate);
+size_t HashTable_mergeAdd(HashTable *dst, HashTable *const *srcs, size_t count, size_t numThreads, Add f);
+size_t HashTable_mergeOverwrite(HashTable *dst, HashTable *const *srcs, size_t count, size_t numThreads, Overwrite f);
 
 #endif // HASHTABLE_H
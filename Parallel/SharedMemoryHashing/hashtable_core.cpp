@@ -0,0 +1,106 @@
+// C ABI for the templated core: provides the HashTable_* functions of
+// hashtable.h on top of hashing::Table, as a drop-in for hashtable.c
+// (make CORE=cpp). The MyElement array is used as the slot storage.
+
+#include <cstddef>
+#include <cstdio>  // For error printing
+#include <cstdlib>
+
+extern "C" {
+#include "hashtable.h"
+}
+#include "table.hpp"
+
+using StringTable = hashing::Table<const char *, long long, hashing::Djb2Hash, hashing::Increment, MAX_DIST>;
+using StringSlot = StringTable::SlotType;
+
+static_assert(sizeof(StringSlot) == sizeof(MyElement), "slot must overlay MyElement");
+static_assert(offsetof(StringSlot, value) == offsetof(MyElement, data), "slot must overlay MyElement");
+static_assert(offsetof(StringSlot, state) == offsetof(MyElement, state), "slot must overlay MyElement");
+static_assert(StringSlot::kBusy == MYELEMENT_BUSY && StringSlot::kReady == MYELEMENT_READY,
+              "claim states must match MyElement's");
+
+static StringSlot *slotsOf(HashTable *ht) {
+    return reinterpret_cast<StringSlot *>(ht->table);
+}
+
+// Hash of a key being inserted; also records the key in the filter
+static size_t hashForInsert(HashTable *ht, const char *key) {
+    size_t h = hashing::Djb2Hash{}(key);
+    if (ht->filter) {
+        BloomFilter_add(ht->filter, h);
+    }
+    return h;
+}
+
+extern "C" const char *HashTable_coreName(void) {
+    return "cpp";
+}
+
+extern "C" HashTable *HashTable_init(size_t logSize) {
+    HashTable *ht = static_cast<HashTable *>(std::malloc(sizeof(HashTable)));
+    if (!ht) {
+        std::fprintf(stderr, "Memory allocation failed for HashTable.\n");
+        return NULL;
+    }
+
+    ht->size = (1ULL << logSize) - 1;
+    ht->mask = ht->size;
+    ht->filter = NULL;
+    // calloc leaves every slot empty, including the claim state in the padding
+    ht->table = static_cast<MyElement *>(std::calloc(ht->size + 1, sizeof(MyElement)));
+    if (!ht->table) {
+        std::free(ht);
+        std::fprintf(stderr, "Memory allocation failed for HashTable table.\n");
+        return NULL;
+    }
+    return ht;
+}
+
+extern "C" void HashTable_free(HashTable *ht) {
+    if (ht->filter) {
+        BloomFilter_free(ht->filter);
+    }
+    std::free(ht->table);
+    std::free(ht);
+}
+
+extern "C" MyElement HashTable_find(HashTable *ht, const char *key) {
+    if (ht->filter && !BloomFilter_mayContain(ht->filter, hashing::Djb2Hash{}(key))) {
+        return MyElement_getEmptyValue();  // Definitely absent, the table is not touched
+    }
+    StringTable table(slotsOf(ht), ht->mask);
+    long long data;
+    if (table.find(key, data)) {
+        return MyElement_init(key, data);
+    }
+    return MyElement_getEmptyValue();
+}
+
+extern "C" bool HashTable_insertOrUpdateIncrement(HashTable *ht, const MyElement *e, Increment) {
+    StringTable table(slotsOf(ht), ht->mask);
+    return table.insertOrUpdateHashed<hashing::Increment>(e->key, hashForInsert(ht, e->key), e->data);
+}
+
+extern "C" bool HashTable_insertOrUpdateIncrementHashed(HashTable *ht, const char *key, size_t hash, Increment) {
+    if (ht->filter) {
+        BloomFilter_add(ht->filter, hash);
+    }
+    StringTable table(slotsOf(ht), ht->mask);
+    return table.insertOrUpdateHashed<hashing::Increment>(key, hash, 1);
+}
+
+extern "C" bool HashTable_insertOrUpdateDecrement(HashTable *ht, const MyElement *e, Decrement) {
+    StringTable table(slotsOf(ht), ht->mask);
+    return table.insertOrUpdateHashed<hashing::Decrement>(e->key, hashForInsert(ht, e->key), e->data);
+}
+
+extern "C" bool HashTable_insertOrUpdateAdd(HashTable *ht, const MyElement *e, Add) {
+    StringTable table(slotsOf(ht), ht->mask);
+    return table.insertOrUpdateHashed<hashing::Add>(e->key, hashForInsert(ht, e->key), e->data);
+}
+
+extern "C" bool HashTable_insertOrUpdateOverwrite(HashTable *ht, const MyElement *e, Overwrite) {
+    StringTable table(slotsOf(ht), ht->mask);
+    return table.insertOrUpdateHashed<hashing::Overwrite>(e->key, hashForInsert(ht, e->key), e->data);
+}
@@ -0,0 +1,10 @@
+#include "hashtable.h"
+
+// Shared by both cores: only the insert and find paths consult the filter
+bool HashTable_enableFilter(HashTable *ht, size_t expectedKeys, double falsePositiveRate) {
+    if (ht->filter) {
+        BloomFilter_free(ht->filter);
+    }
+    ht->filter = BloomFilter_init(expectedKeys, falsePositiveRate);
+    return ht->filter != NULL;
+}
@@ -0,0 +1,99 @@
+#include "hashtable.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef enum { MERGE_ADD, MERGE_OVERWRITE } MergePolicy;
+
+// One thread's share of a merge: the same slot range of every source
+typedef struct {
+    HashTable *dst;
+    HashTable *const *srcs;
+    size_t count;
+    size_t part;
+    size_t parts;
+    MergePolicy policy;
+    size_t failed;
+    bool started;  // False when pthread_create failed and the caller ran the range
+} MergeArgs;
+
+static void *mergeRange(void *args) {
+    MergeArgs *m = (MergeArgs *)args;
+
+    for (size_t s = 0; s < m->count; ++s) {
+        HashTable *src = m->srcs[s];
+        size_t slots = src->size + 1;
+        size_t begin = slots * m->part / m->parts;
+        size_t end = slots * (m->part + 1) / m->parts;
+
+        // Walk the source array directly instead of going through its API
+        for (size_t i = begin; i < end; ++i) {
+            const MyElement *e = &src->table[i];
+            if (MyElement_isEmpty(e)) {
+                continue;
+            }
+            bool ok = m->policy == MERGE_ADD ? HashTable_insertOrUpdateAdd(m->dst, e, (Add){})
+                                             : HashTable_insertOrUpdateOverwrite(m->dst, e, (Overwrite){});
+            if (!ok) {
+                m->failed++;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Merge `count` tables into dst with numThreads threads, each scanning one
+// slot range of every source. Sources must not be written during the merge;
+// dst may be. Returns the number of elements that did not fit into dst.
+static size_t merge(HashTable *dst, HashTable *const *srcs, size_t count, size_t numThreads, MergePolicy policy) {
+    if (numThreads == 0) {
+        numThreads = 1;
+    }
+    pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+    MergeArgs *args = malloc(numThreads * sizeof(MergeArgs));
+    if (!threads || !args) {
+        free(threads);
+        free(args);
+        return (size_t)-1;
+    }
+
+    for (size_t t = 0; t < numThreads; ++t) {
+        args[t] = (MergeArgs){dst, srcs, count, t, numThreads, policy, 0, true};
+        if (pthread_create(&threads[t], NULL, mergeRange, &args[t]) != 0) {
+            // Out of threads: merge this range here rather than dropping it
+            args[t].started = false;
+            mergeRange(&args[t]);
+        }
+    }
+
+    size_t failed = 0;
+    for (size_t t = 0; t < numThreads; ++t) {
+        if (args[t].started) {
+            pthread_join(threads[t], NULL);
+        }
+        failed += args[t].failed;
+    }
+    free(threads);
+    free(args);
+    return failed;
+}
+
+size_t HashTable_mergeAdd(HashTable *dst, HashTable *const *srcs, size_t count, size_t numThreads, Add f) {
+    (void)f;
+    return merge(dst, srcs, count, numThreads, MERGE_ADD);
+}
+
+// A key can sit in different slots of different sources, so with one pass the
+// thread that writes it last would win. Sources are merged one after another
+// instead, each still split over all threads: the last source holding a key wins.
+size_t HashTable_mergeOverwrite(HashTable *dst, HashTable *const *srcs, size_t count, size_t numThreads, Overwrite f) {
+    (void)f;
+    size_t failed = 0;
+    for (size_t s = 0; s < count; ++s) {
+        size_t sourceFailed = merge(dst, &srcs[s], 1, numThreads, MERGE_OVERWRITE);
+        if (sourceFailed == (size_t)-1) {
+            return sourceFailed;
+        }
+        failed += sourceFailed;
+    }
+    return failed;
+}
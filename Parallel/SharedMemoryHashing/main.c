@@ -1,46 +1,771 @@
-#include "hashtable.h"
+#define _POSIX_C_SOURCE 200809L // For strdup under -std=c11
+
 #include "my_element.h"
+#include "stream_reader.h"
+#include "sketch.h"
+#include "tokenizer.h"
+#include "profiler.h"
+#include "shared_hashtable.h"
+#include "table_sizing.h"
+#include "windowed_hashtable.h"
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #define NUM_THREADS 32
 #define MAX_WORDS 10000000 // Total words to handle
 #define FILE_READS 10      // Number of times to read the file
 #define MAX_WORD_LENGTH 50
+#define MIN_STREAM_SLICE (64 * 1024) // Smallest part of a streamed chunk worth a thread
+#define TOKEN_BATCH 256              // Tokens scanned per Tokenizer_scan call
+#define MAIN_WORKER NUM_THREADS      // Profiler row of the main thread
+
+// Table engine, selected at build time (make ENGINE=cuckoo)
+#ifdef USE_CUCKOO
+#include "cuckoo_hashtable.h"
+typedef CuckooHashTable Table;
+#define Table_init CuckooHashTable_init
+#define Table_free CuckooHashTable_free
+#define Table_insertOrUpdateIncrement CuckooHashTable_insertOrUpdateIncrement
+#define Table_insertOrUpdateIncrementHashed CuckooHashTable_insertOrUpdateIncrementHashed
+#define Table_find CuckooHashTable_find
+#else
+#include "hashtable.h"
+typedef HashTable Table;
+#define Table_init HashTable_init
+#define Table_free HashTable_free
+#define Table_insertOrUpdateIncrement HashTable_insertOrUpdateIncrement
+#define Table_insertOrUpdateIncrementHashed HashTable_insertOrUpdateIncrementHashed
+#define Table_find HashTable_find
+#endif
 
 // Structure to pass arguments to threads
 typedef struct {
-    HashTable *ht;
+    Table *ht;
     char **words;
     int start;
     int end;
+    int worker;
 } ThreadArgs;
 
-// Thread function for parallel inserts
+// Sketch mode (--sketch): words go to a fixed-size sketch instead of the exact table.
+// When every insert thread has a core, each fills a sketch of its own, so hot keys
+// do not make them contend on the same counters, and it is merged into sketch when
+// the thread finishes. Time-sliced threads gain nothing from that and only add
+// cache misses, so with more threads than cores they share sketch.
+Sketch *sketch = NULL;
+bool threadSketches = false;
+__thread Sketch *threadSketch = NULL;
+
+// Give the calling thread its own sketch; without one it adds to the shared one
+void startThreadSketch(void) {
+    if (sketch && threadSketches) {
+        threadSketch = Sketch_init();
+    }
+}
+
+// Fold a finished thread's sketch, returned from its thread function, into sketch
+void mergeThreadSketch(void *result) {
+    Sketch *local = (Sketch *)result;
+    if (local) {
+        Sketch_merge(sketch, local);
+        Sketch_free(local);
+    }
+}
+
+// Windowed mode (--window [seconds]): streamed words go to a table that keeps
+// per-epoch counts, and a new epoch starts every windowSeconds of wall-clock
+// time, so the table answers "how often in the last WINDOW_EPOCHS epochs".
+// --window-chunks n starts one every n chunks instead. That is a test knob
+// for repeatable runs: from a pipe a chunk is whatever read() returned, so
+// a chunk epoch can last milliseconds or minutes.
+WindowedHashTable *window = NULL;
+double windowSeconds = 0;
+int windowChunks = 0;
+double epochStart = 0;  // CLOCK_MONOTONIC seconds at which the current epoch began
+
+double monotonicSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Start every epoch the clock has reached since epochStart. WINDOW_EPOCHS
+// advances already expire every cell, so a long pause costs no more than that.
+void advanceWindowClock(void) {
+    double elapsed = monotonicSeconds() - epochStart;
+    if (windowSeconds <= 0 || elapsed < windowSeconds) {
+        return;
+    }
+    long long due = (long long)(elapsed / windowSeconds);
+    for (long long i = 0; i < due && i < WINDOW_EPOCHS; ++i) {
+        WindowedHashTable_advanceEpoch(window);  // O(1), old epochs expire lazily
+    }
+    epochStart += due * windowSeconds;  // Boundaries stay on the grid the first epoch set
+}
+
+// Shared mode (--shared name): the table lives in a POSIX shared-memory segment
+const char *sharedName = NULL;
+
+// Bloom filter mode (--bloom [rate]): false-positive rate of the table's filter, 0 for none
+double bloomRate = 0.0;
+
+// Insert threads actually used, at most NUM_THREADS (--auto-size may pick fewer)
+int numThreads = NUM_THREADS;
+
+// Insert path shared by every ingestion mode, false if the table had no room
+bool ingestWord(Table *ht, const char *word) {
+    if (sketch) {
+        Sketch_add(threadSketch ? threadSketch : sketch, word, 1);
+        return true;
+    }
+
+    MyElement e = MyElement_init(word, 1);  // Use string as key
+    if (window) {
+        return WindowedHashTable_insertOrUpdateIncrement(window, &e, (Increment){});
+    }
+    return Table_insertOrUpdateIncrement(ht, &e, (Increment){});
+}
+
+// Insert path for a token from Tokenizer_scan, reusing its hash
+bool ingestToken(Table *ht, const char *word, const Token *token) {
+    if (token->length >= MAX_KEY_LENGTH || window) {
+        return ingestWord(ht, word);  // Stored truncated, so the full-length hash does not apply
+    }
+    if (sketch) {
+        Sketch_addHashed(threadSketch ? threadSketch : sketch, token->hash, 1);
+        return true;
+    }
+    return Table_insertOrUpdateIncrementHashed(ht, word, token->hash, (Increment){});
+}
+
+// Thread function for parallel inserts; returns its sketch in sketch mode
 void *threadInsert(void *args) {
     ThreadArgs *tArgs = (ThreadArgs *)args;
 
+    startThreadSketch();
+    Profiler_begin(tArgs->worker, PHASE_INSERT);
     for (int i = tArgs->start; i < tArgs->end; ++i) {
-        MyElement e = MyElement_init(tArgs->words[i], 1);  // Use string as key
-        if (!HashTable_insertOrUpdateIncrement(tArgs->ht, &e, (Increment){})) {
+        if (!ingestWord(tArgs->ht, tArgs->words[i])) {
             printf("Failed to insert key \"%s\"\n", tArgs->words[i]);
         }
     }
-    return NULL;
+    Profiler_end(tArgs->worker, PHASE_INSERT);
+    Profiler_threadDone();
+    return threadSketch;
+}
+
+// Table of 2^logSize slots, in the shared-memory segment with --shared
+Table *initTable(size_t logSize) {
+    if (sharedName) {
+#ifdef USE_CUCKOO
+        fprintf(stderr, "--shared needs the linear engine\n");
+        return NULL;
+#else
+        Table *ht = SharedHashTable_open(sharedName, logSize);
+        if (ht) {
+            printf("Shared HashTable %s attached with %zu slots\n", sharedName, ht->size + 1);
+        }
+        return ht;
+#endif
+    }
+    Table *ht = Table_init(logSize);
+    if (ht) {
+        printf("HashTable initialized with %zu slots\n", (size_t)1 << logSize);
+    }
+#ifndef USE_CUCKOO
+    // Sized for the keys the table holds at the auto-size target load
+    if (ht && bloomRate > 0 && !HashTable_enableFilter(ht, (size_t)((1ULL << logSize) * AUTO_TARGET_LOAD), bloomRate)) {
+        Table_free(ht);
+        return NULL;
+    }
+#endif
+    return ht;
+}
+
+// Keys of one slice that found no room, kept for growTable. They point into
+// the chunk, so they must be inserted before the next chunk is read.
+typedef struct {
+    const char **keys;
+    size_t count;
+    size_t capacity;
+} FailedKeys;
+
+// Structure to pass one slice of a streamed chunk to a thread
+typedef struct {
+    Table *ht;
+    char *text;
+    size_t length;
+    long long words;
+    int worker;
+    FailedKeys *failed;  // NULL unless the table can grow: failures are reported instead
+} StreamSliceArgs;
+
+// Streaming into a process-local table sized by --auto-size: a table the
+// estimate left too small is rebuilt larger between chunks
+bool growOnFull = false;
+FailedKeys failedKeys[NUM_THREADS];
+
+void recordFailed(StreamSliceArgs *sArgs, const char *word) {
+    FailedKeys *f = sArgs->failed;
+    if (f && f->count == f->capacity) {
+        size_t capacity = f->capacity ? f->capacity * 2 : TOKEN_BATCH;
+        const char **keys = realloc(f->keys, capacity * sizeof(const char *));
+        if (keys) {
+            f->keys = keys;
+            f->capacity = capacity;
+        }
+    }
+    if (!f || f->count == f->capacity) {
+        printf("Failed to insert key \"%s\"\n", word);
+        return;
+    }
+    f->keys[f->count++] = word;
+}
+
+// Copy every element of src into the empty table dst, returns how many did not fit
+size_t moveElements(Table *dst, Table *src) {
+#ifdef USE_CUCKOO
+    size_t failed = 0;
+    for (size_t b = 0; b <= src->mask; ++b) {
+        for (int s = 0; s < CUCKOO_SLOTS_PER_BUCKET; ++s) {
+            if (src->buckets[b].tags[s] != 0 &&
+                !CuckooHashTable_insertOrUpdateOverwrite(dst, &src->buckets[b].slots[s], (Overwrite){})) {
+                failed++;
+            }
+        }
+    }
+    return failed;
+#else
+    return HashTable_mergeAdd(dst, &src, 1, numThreads, (Add){});
+#endif
+}
+
+// Replace ht's contents with a table of at least twice the slots holding the
+// same elements; ht keeps its address, so the slices' pointers stay valid.
+// False if no bigger table could be allocated.
+bool rebuildLarger(Table *ht) {
+#ifdef USE_CUCKOO
+    size_t slots = ht->size;
+#else
+    size_t slots = ht->size + 1;
+#endif
+    size_t logSize = 1;
+    while (((size_t)1 << logSize) <= slots) {
+        logSize++;
+    }
+    for (; logSize < AUTO_MAX_LOG_SIZE + 8; ++logSize) {
+        printf("Table full, the auto-size estimate was too low: rebuilding it\n");
+        Table *bigger = initTable(logSize);
+        if (!bigger) {
+            return false;
+        }
+        if (moveElements(bigger, ht) == 0) {
+            Table old = *ht;
+            *ht = *bigger;
+            *bigger = old;
+            Table_free(bigger);  // Now the old slots
+            return true;
+        }
+        Table_free(bigger);
+    }
+    return false;
+}
+
+// Insert the keys the slices of a chunk had no room for, rebuilding the table
+// larger first. Runs between chunks, while no slice thread is inserting.
+void growTable(Table *ht, FailedKeys *failed, int lists) {
+    for (int l = 0; l < lists; ++l) {
+        for (size_t i = 0; i < failed[l].count; ++i) {
+            MyElement e = MyElement_init(failed[l].keys[i], 1);
+            while (!Table_insertOrUpdateIncrement(ht, &e, (Increment){})) {
+                if (!rebuildLarger(ht)) {
+                    printf("Failed to insert key \"%s\"\n", failed[l].keys[i]);
+                    break;
+                }
+            }
+        }
+        failed[l].count = 0;
+    }
+}
+
+// Streaming: tokenize and hash a slice in one pass, then insert each batch
+// of tokens with the hashes already computed
+void insertSlice(StreamSliceArgs *sArgs) {
+    Token tokens[TOKEN_BATCH];
+    char *text = sArgs->text;
+    size_t remaining = sArgs->length;
+
+    while (remaining > 0) {
+        size_t consumed;
+        Profiler_begin(sArgs->worker, PHASE_TOKENIZE);
+        size_t count = Tokenizer_scan(text, remaining, tokens, TOKEN_BATCH, &consumed);
+        Profiler_end(sArgs->worker, PHASE_TOKENIZE);
+
+        Profiler_begin(sArgs->worker, PHASE_INSERT);
+        for (size_t i = 0; i < count; ++i) {
+            if (!ingestToken(sArgs->ht, text + tokens[i].offset, &tokens[i])) {
+                recordFailed(sArgs, text + tokens[i].offset);
+            }
+        }
+        Profiler_end(sArgs->worker, PHASE_INSERT);
+        sArgs->words += count;
+        text += consumed;
+        remaining -= consumed;
+    }
+}
+
+// Slice threads of the streaming mode. They are started once and wait at
+// chunkReady for every chunk, so a long stream does not create threads (and,
+// with --profile, open counter groups) per chunk.
+typedef struct {
+    pthread_t threads[NUM_THREADS];
+    StreamSliceArgs args[NUM_THREADS];
+    pthread_barrier_t chunkReady;
+    pthread_barrier_t chunkDone;
+    int started;
+    int slices;  // Slices of the current chunk, 0 to stop the threads
+} SlicePool;
+
+SlicePool slicePool;
+
+void *threadSliceLoop(void *arg) {
+    int index = (int)(intptr_t)arg;
+    startThreadSketch();
+    while (true) {
+        pthread_barrier_wait(&slicePool.chunkReady);
+        if (slicePool.slices == 0) {
+            break;
+        }
+        if (index < slicePool.slices) {
+            insertSlice(&slicePool.args[index]);
+        }
+        pthread_barrier_wait(&slicePool.chunkDone);
+    }
+    Profiler_threadDone();
+    return threadSketch;
 }
 
-int main() {
+// False if a thread could not be created. The ones that were stay parked at
+// chunkReady, which cannot release them, until the process exits.
+bool slicePoolStart(int threads) {
+    pthread_barrier_init(&slicePool.chunkReady, NULL, threads + 1);
+    pthread_barrier_init(&slicePool.chunkDone, NULL, threads + 1);
+    for (slicePool.started = 0; slicePool.started < threads; ++slicePool.started) {
+        if (pthread_create(&slicePool.threads[slicePool.started], NULL, threadSliceLoop,
+                           (void *)(intptr_t)slicePool.started) != 0) {
+            perror("Failed to create thread");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hand the first `slices` args to the pool and wait until all are inserted
+void slicePoolRun(int slices) {
+    slicePool.slices = slices;
+    pthread_barrier_wait(&slicePool.chunkReady);
+    pthread_barrier_wait(&slicePool.chunkDone);
+}
+
+void slicePoolStop(void) {
+    slicePool.slices = 0;
+    pthread_barrier_wait(&slicePool.chunkReady);
+    for (int i = 0; i < slicePool.started; ++i) {
+        void *result;
+        pthread_join(slicePool.threads[i], &result);
+        mergeThreadSketch(result);
+    }
+    pthread_barrier_destroy(&slicePool.chunkReady);
+    pthread_barrier_destroy(&slicePool.chunkDone);
+}
+
+// Streaming mode: read the input chunk by chunk and insert each chunk in
+// parallel before reading the next, so memory stays at one chunk plus the table.
+// Returns the number of words inserted or -1 if the input cannot be opened.
+long long streamInsert(Table *ht, const char *path) {
+    StreamReader *reader = StreamReader_open(path);
+    if (!reader) {
+        return -1;
+    }
+    if (!slicePoolStart(numThreads)) {
+        StreamReader_close(reader);
+        return -1;
+    }
+
+    StreamSliceArgs *args = slicePool.args;
+    long long totalWords = 0;
+    long long chunks = 0;
+    size_t length;
+    char *chunk;
+
+    while (true) {
+        Profiler_begin(MAIN_WORKER, PHASE_READ);
+        chunk = StreamReader_next(reader, &length);
+        Profiler_end(MAIN_WORKER, PHASE_READ);
+        if (!chunk) {
+            break;
+        }
+        // Words are counted in the epoch their chunk arrived in
+        if (window && windowChunks > 0) {
+            if (chunks > 0 && chunks % windowChunks == 0) {
+                WindowedHashTable_advanceEpoch(window);
+            }
+        } else if (window) {
+            advanceWindowClock();
+        }
+        chunks++;
+
+        char *chunkEnd = chunk + length;
+        size_t sliceSize = length / numThreads > MIN_STREAM_SLICE ? length / numThreads : MIN_STREAM_SLICE;
+        int slices = 0;
+
+        // Cut the chunk into slices that end on a delimiter
+        for (char *sliceStart = chunk; sliceStart < chunkEnd && slices < numThreads; ++slices) {
+            char *sliceEnd = slices == numThreads - 1 || (size_t)(chunkEnd - sliceStart) <= sliceSize
+                                 ? chunkEnd
+                                 : sliceStart + sliceSize;
+            while (sliceEnd < chunkEnd && !strchr(TOKEN_DELIMITERS, *sliceEnd)) {
+                sliceEnd++;
+            }
+            *sliceEnd = '\0';  // Either a delimiter or the chunk terminator
+
+            args[slices] = (StreamSliceArgs){ht, sliceStart, (size_t)(sliceEnd - sliceStart), 0, slices,
+                                             growOnFull ? &failedKeys[slices] : NULL};
+            sliceStart = sliceEnd + 1;
+        }
+
+        if (slices == 1) {
+            args[0].worker = MAIN_WORKER;
+            insertSlice(&args[0]);  // Small chunk, e.g. one line from a pipe
+        } else {
+            slicePoolRun(slices);
+        }
+        for (int i = 0; i < slices; ++i) {
+            totalWords += args[i].words;
+        }
+        if (growOnFull) {
+            growTable(ht, failedKeys, slices);
+        }
+    }
+
+    slicePoolStop();
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        free(failedKeys[i].keys);
+    }
+    StreamReader_close(reader);
+    return totalWords;
+}
+
+void printExecutionTime(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+    printf("Program execution time: %.6f seconds\n", elapsed);
+}
+
+void printSketchSummary(void) {
+    printf("Sketch memory: %zu bytes, estimated distinct words: %.0f\n", Sketch_bytes(),
+           Sketch_estimateDistinct(sketch));
+}
+
+// Counts of the --find keys in the current epoch and over the whole window
+void printWindowSummary(const char **keys, int count) {
+    if (windowChunks > 0) {
+        printf("Windowed table: epoch %u, %d epochs of %d chunks each\n", window->epoch, WINDOW_EPOCHS, windowChunks);
+    } else {
+        advanceWindowClock();  // Time without input still moves the window
+        printf("Windowed table: epoch %u, %d epochs of %g s each\n", window->epoch, WINDOW_EPOCHS, windowSeconds);
+    }
+    for (int i = 0; i < count; ++i) {
+        printf("Key: %s, Current epoch: %lld, Window: %lld\n", keys[i],
+               WindowedHashTable_findWindow(window, keys[i], 1), WindowedHashTable_find(window, keys[i]).data);
+    }
+}
+
+// Counts of the --find keys in the exact table
+void printFindResults(Table *ht, const char **keys, int count) {
+    for (int i = 0; i < count; ++i) {
+        MyElement e = Table_find(ht, keys[i]);
+        printf("Key: %s, Count: %lld\n", keys[i], e.data);
+    }
+}
+
+void freeTables(Table *ht) {
+    if (sketch) {
+        Sketch_free(sketch);
+    } else if (window) {
+        WindowedHashTable_free(window);
+    } else if (sharedName) {
+#ifndef USE_CUCKOO
+        SharedHashTable_close(ht);  // Other processes may still use the segment
+#endif
+    } else {
+        Table_free(ht);
+    }
+}
+
+void printFilterSummary(Table *ht) {
+#ifdef USE_CUCKOO
+    (void)ht;
+#else
+    if (ht && ht->filter) {
+        printf("Bloom filter: %zu bytes for %zu keys, false-positive rate %.4f%% target, %.4f%% measured\n",
+               BloomFilter_bytes(ht->filter), ht->filter->expectedKeys, ht->filter->targetRate * 100,
+               BloomFilter_falsePositiveRate(ht->filter) * 100);
+    }
+#endif
+}
+
+// Roll the --merge snapshots (shared tables left by earlier runs) into ht.
+// Counts are added, or with --merge-overwrite the last snapshot holding a key wins.
+bool mergeSnapshots(Table *ht, const char **names, int count, bool overwrite) {
+#ifdef USE_CUCKOO
+    (void)ht;
+    (void)names;
+    (void)overwrite;
+    if (count > 0) {
+        fprintf(stderr, "--merge needs the linear engine\n");
+        return false;
+    }
+    return true;
+#else
+    if (count == 0) {
+        return true;
+    }
+    HashTable **sources = malloc(count * sizeof(HashTable *));
+    if (!sources) {
+        return false;
+    }
+    int opened = 0;
+    while (opened < count && (sources[opened] = SharedHashTable_attach(names[opened])) != NULL) {
+        opened++;
+    }
+
+    bool ok = opened == count;
+    if (ok) {
+        size_t failed = overwrite ? HashTable_mergeOverwrite(ht, sources, count, numThreads, (Overwrite){})
+                                  : HashTable_mergeAdd(ht, sources, count, numThreads, (Add){});
+        printf("Merged %d snapshot(s), %zu elements did not fit\n", count, failed);
+        ok = failed != (size_t)-1;
+    }
+    for (int i = 0; i < opened; ++i) {
+        SharedHashTable_close(sources[i]);
+    }
+    free(sources);
+    return ok;
+#endif
+}
+
+// Write the per-phase profile to profilePath, or stderr when none was given
+void writeProfile(const char *profilePath) {
+    FILE *out = profilePath ? fopen(profilePath, "w") : stderr;
+    if (!out) {
+        perror("Could not open profile output");
+        return;
+    }
+    Profiler_report(out);
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+// Usage: main_program [--sketch]                    read the sample file FILE_READS times
+//        main_program [--sketch] --stream [file|-]  stream a file or stdin with bounded memory
+//        main_program --shared name --find word [--find word ...]  look words up, no ingestion
+//        (likewise with --merge instead of or besides --shared; in every other mode
+//        --find keys are looked up once the input has been ingested)
+// Add --profile [file] to either for per-phase profiling as JSON lines (stderr by default).
+// Add --shared name to keep the table in POSIX shared memory, created on first use and
+// attached to by later processes; --unlink removes the segment when the process ends.
+// Add --auto-size to size the table and pick the thread count from a distinct-key
+// estimate: over the words read in the default mode, over a sample of a streamed file.
+// A streamed process-local table the estimate left too small is rebuilt larger.
+// Add --bloom [rate] to put a Bloom filter (default rate 0.01) in front of table lookups.
+// Add --merge name (repeatable) to start from shared tables left by earlier runs, adding
+// their counts; --merge-overwrite lets the last snapshot holding a key win instead.
+// Add --window [seconds] to --stream to count per epoch instead of in total, starting a new
+// epoch every `seconds` of wall-clock time (default 60), so the window covers the last
+// WINDOW_EPOCHS epochs; --find keys are then reported after the stream. --window-chunks n
+// starts an epoch every n chunks instead, for repeatable tests.
+int main(int argc, char **argv) {
     // Measure time
-    struct timespec start, end;
+    struct timespec start;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
-    // Initialize the hash table
-    size_t logSize = 24; // 2^24 slots in the hash table (16M slots)
-    HashTable *ht = HashTable_init(logSize);
-    printf("HashTable initialized with %d slots\n", 1 << logSize);
+    bool useSketch = false;
+    const char *streamPath = NULL;
+    const char *profilePath = NULL;
+    bool unlinkShared = false;
+    bool autoSize = false;
+    bool mergeOverwrite = false;
+    const char **findKeys = malloc(argc * sizeof(char *));
+    const char **mergeNames = malloc(argc * sizeof(char *));
+    int findCount = 0;
+    int mergeCount = 0;
+    if (!findKeys || !mergeNames) {
+        return EXIT_FAILURE;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--sketch") == 0) {
+            useSketch = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streamPath = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : "-";
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            Profiler_enable();
+            profilePath = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : NULL;
+        } else if (strcmp(argv[i], "--shared") == 0 && i + 1 < argc) {
+            sharedName = argv[++i];
+        } else if (strcmp(argv[i], "--bloom") == 0) {
+            bloomRate = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? atof(argv[++i]) : 0.01;
+        } else if (strcmp(argv[i], "--auto-size") == 0) {
+            autoSize = true;
+        } else if (strcmp(argv[i], "--unlink") == 0) {
+            unlinkShared = true;
+        } else if (strcmp(argv[i], "--window") == 0) {
+            windowSeconds = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? atof(argv[++i]) : 60;
+            if (windowSeconds <= 0) {
+                windowSeconds = 60;
+            }
+        } else if (strcmp(argv[i], "--window-chunks") == 0 && i + 1 < argc) {
+            windowChunks = atoi(argv[++i]);
+            if (windowChunks < 1) {
+                windowChunks = 1;
+            }
+        } else if (strcmp(argv[i], "--merge") == 0 && i + 1 < argc) {
+            mergeNames[mergeCount++] = argv[++i];
+        } else if (strcmp(argv[i], "--merge-overwrite") == 0) {
+            mergeOverwrite = true;
+        } else if (strcmp(argv[i], "--find") == 0 && i + 1 < argc) {
+            findKeys[findCount++] = argv[++i];
+        }
+    }
+
+    bool windowed = windowSeconds > 0 || windowChunks > 0;
+    if (useSketch && findCount > 0) {
+        fprintf(stderr, "--find needs a table to query, a new --sketch is always empty\n");
+        free(findKeys);
+        free(mergeNames);
+        return EXIT_FAILURE;
+    }
+    if (mergeCount > 0 && (useSketch || windowed)) {
+        fprintf(stderr, "--merge needs the exact table, not --sketch or --window\n");
+        return EXIT_FAILURE;
+    }
+    if (windowed && (!streamPath || useSketch || sharedName)) {
+        fprintf(stderr, "--window needs --stream and cannot be combined with --sketch or --shared\n");
+        free(findKeys);
+        free(mergeNames);
+        return EXIT_FAILURE;
+    }
+
+    // Only the exact, process-local linear table consults a filter
+    if (bloomRate > 0) {
+#ifdef USE_CUCKOO
+        fprintf(stderr, "--bloom is ignored: the cuckoo engine has no filter\n");
+#else
+        if (sharedName) {
+            fprintf(stderr, "--bloom is ignored with --shared: a filter in one process would miss other processes' inserts\n");
+        } else if (useSketch || windowed) {
+            fprintf(stderr, "--bloom is ignored with --sketch and --window\n");
+        }
+#endif
+    }
+
+    // 2^24 slots in the hash table (16M slots) unless auto-sized. Window slots
+    // hold WINDOW_EPOCHS counts each, so the windowed table starts smaller.
+    size_t logSize = windowed ? WINDOW_DEFAULT_LOG_SIZE : 24;
+    if (autoSize && streamPath && !useSketch) {
+        TableSizing sizing;
+        if (TableSizing_fromFile(streamPath, NUM_THREADS, &sizing)) {
+            TableSizing_print(&sizing);
+            logSize = sizing.logSize;
+            numThreads = sizing.threads;
+            // Other processes may be attached to a shared table, so only a local one is rebuilt
+            growOnFull = !sharedName && !windowed;
+        } else {
+            printf("Auto-size needs a regular file to sample, using the default size\n");
+        }
+    }
+
+    // Only a table that outlives this process, or one built from snapshots, has
+    // anything to query before ingesting
+    bool queryOnly = findCount > 0 && (sharedName || mergeCount > 0) && !streamPath;
+
+    // Initialize the hash table, or the sketch that replaces it. When auto-sizing
+    // in the default mode, the table is created once the words have been read.
+    bool deferTable = autoSize && !streamPath && !useSketch && !queryOnly;
+    Table *ht = NULL;
+    if (useSketch) {
+        sketch = Sketch_init();
+        if (!sketch) {
+            return EXIT_FAILURE;
+        }
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadSketches = cores > 0 && numThreads <= cores;
+        printf("Sketch initialized with %zu bytes\n", Sketch_bytes());
+    } else if (windowed) {
+        window = WindowedHashTable_init(logSize);
+        if (!window) {
+            return EXIT_FAILURE;
+        }
+        epochStart = monotonicSeconds();
+        printf("Windowed HashTable initialized with %zu slots\n", window->size + 1);
+    } else if (!deferTable) {
+        ht = initTable(logSize);
+        if (!ht || !mergeSnapshots(ht, mergeNames, mergeCount, mergeOverwrite)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Query mode: look the keys up and leave the table as it is
+    if (queryOnly) {
+        printFindResults(ht, findKeys, findCount);
+        free(findKeys);
+        free(mergeNames);
+        freeTables(ht);
+        if (sharedName && unlinkShared) {
+            SharedHashTable_unlink(sharedName);
+        }
+        return 0;
+    }
+
+    if (streamPath) {
+        long long streamed = streamInsert(ht, streamPath);
+        if (streamed >= 0) {
+            printf("Total words streamed: %lld\n", streamed);
+            if (sketch) {
+                printSketchSummary();
+            }
+            if (window) {
+                printWindowSummary(findKeys, findCount);
+            } else if (!sketch) {
+                printFindResults(ht, findKeys, findCount);
+            }
+            printFilterSummary(ht);
+        }
+        Profiler_begin(MAIN_WORKER, PHASE_TEARDOWN);
+        freeTables(ht);
+        Profiler_end(MAIN_WORKER, PHASE_TEARDOWN);
+        free(findKeys);
+        free(mergeNames);
+        if (Profiler_enabled()) {
+            writeProfile(profilePath);
+        }
+        if (sharedName && unlinkShared) {
+            SharedHashTable_unlink(sharedName);
+        }
+        if (streamed < 0) {
+            return EXIT_FAILURE;
+        }
+        printExecutionTime(&start);
+        return 0;
+    }
 
     // Allocate memory to store words
     char **words = malloc(MAX_WORDS * sizeof(char *));
@@ -54,6 +779,8 @@ int main() {
     char line[4096];
     int totalWords = 0;
 
+    // Reading and tokenizing are interleaved per line here, both count as read
+    Profiler_begin(MAIN_WORKER, PHASE_READ);
     for (int pass = 0; pass < FILE_READS; ++pass) {
         FILE *file = fopen(filePath, "r");
         if (!file) {
@@ -74,22 +801,38 @@ int main() {
         }
         fclose(file);
     }
-
+    Profiler_end(MAIN_WORKER, PHASE_READ);
 
     printf("Total words read: %d\n", totalWords);
 
+    if (deferTable) {
+        TableSizing sizing = TableSizing_fromWords(words, totalWords, NUM_THREADS);
+        TableSizing_print(&sizing);
+        numThreads = sizing.threads;
+        ht = initTable(sizing.logSize);
+        if (!ht || !mergeSnapshots(ht, mergeNames, mergeCount, mergeOverwrite)) {
+            for (int i = 0; i < totalWords; ++i) {
+                free(words[i]);
+            }
+            free(words);
+            return EXIT_FAILURE;
+        }
+    }
+    free(mergeNames);
+
     // Step 2: Split work among threads
     pthread_t threads[NUM_THREADS];
     ThreadArgs args[NUM_THREADS];
-    int wordsPerThread = totalWords / NUM_THREADS;
-    int remainder = totalWords % NUM_THREADS;
+    int wordsPerThread = totalWords / numThreads;
+    int remainder = totalWords % numThreads;
 
     int currentWord = 0;
-    for (int i = 0; i < NUM_THREADS; ++i) {
+    for (int i = 0; i < numThreads; ++i) {
         args[i].ht = ht;
         args[i].words = words;
         args[i].start = currentWord;
         args[i].end = currentWord + wordsPerThread;
+        args[i].worker = i;
 
         if (remainder > 0) {
             args[i].end++;
@@ -105,25 +848,45 @@ int main() {
     }
 
     // Step 3: Join threads
-    for (int i = 0; i < NUM_THREADS; ++i) {
-        if (pthread_join(threads[i], NULL) != 0) {
+    for (int i = 0; i < numThreads; ++i) {
+        void *result;
+        if (pthread_join(threads[i], &result) != 0) {
             printf("Failed to join thread %d\n", i);
             free(words);
             return EXIT_FAILURE;
         }
+        mergeThreadSketch(result);
+    }
+
+    if (sketch) {
+        printSketchSummary();
+    }
+#ifdef USE_CUCKOO
+    else {
+        printf("Cuckoo load factor: %.4f\n", CuckooHashTable_loadFactor(ht));
     }
+#endif
+    printFindResults(ht, findKeys, findCount);
+    free(findKeys);
+    printFilterSummary(ht);
 
     // Step 4: Cleanup
+    Profiler_begin(MAIN_WORKER, PHASE_TEARDOWN);
     for (int i = 0; i < totalWords; ++i) {
         free(words[i]);
     }
     free(words);
-    HashTable_free(ht);
+    freeTables(ht);
+    Profiler_end(MAIN_WORKER, PHASE_TEARDOWN);
+    if (Profiler_enabled()) {
+        writeProfile(profilePath);
+    }
+    if (sharedName && unlinkShared) {
+        SharedHashTable_unlink(sharedName);
+    }
 
     // Measure time
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-    printf("Program execution time: %.6f seconds\n", elapsed);
+    printExecutionTime(&start);
 
     return 0;
 }
@@ -12,6 +12,7 @@ MyElement MyElement_init(const char *key, long long data) {
     MyElement e;
     strncpy(e.key, key, MAX_KEY_LENGTH - 1);  // Copy key string
     e.key[MAX_KEY_LENGTH - 1] = '\0';         // Ensure null-terminated
+    e.state = e.key[0] == '\0' ? MYELEMENT_EMPTY : MYELEMENT_READY;
     e.data = data;
     return e;
 }
@@ -46,3 +47,24 @@ bool MyElement_CAS(MyElement *expected, const MyElement *desired) {
         // Retry the CAS operation
     }
 }
+
+bool MyElement_isFree(const MyElement *slot) {
+    uint32_t state;
+    while ((state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) == MYELEMENT_BUSY) {
+        // The claimer is still copying its key in
+    }
+    return state == MYELEMENT_EMPTY;
+}
+
+bool MyElement_claim(MyElement *slot, const MyElement *desired) {
+    uint32_t expected = MYELEMENT_EMPTY;
+    if (!__atomic_compare_exchange_n(&slot->state, &expected, MYELEMENT_BUSY, false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        return false;
+    }
+    strncpy(slot->key, desired->key, MAX_KEY_LENGTH - 1);
+    slot->key[MAX_KEY_LENGTH - 1] = '\0';
+    slot->data = desired->data;  // Nobody reads it before the state is READY
+    __atomic_store_n(&slot->state, MYELEMENT_READY, __ATOMIC_RELEASE);
+    return true;
+}
@@ -7,8 +7,14 @@
 
 #define MAX_KEY_LENGTH 100
 
+// Claim states of a table slot. Same values and offset as the C++ core's string slot.
+#define MYELEMENT_EMPTY 0
+#define MYELEMENT_BUSY 1   // Key is being copied in; wait before reading it
+#define MYELEMENT_READY 2
+
 typedef struct {
     char key[MAX_KEY_LENGTH];  // String key
+    uint32_t state;            // Claim state when the element is a table slot
     long long data;            // Associated data (e.g., count)
 } MyElement;
 
@@ -17,5 +23,10 @@ MyElement MyElement_init(const char *key, long long data);
 MyElement MyElement_getEmptyValue();
 bool MyElement_isEmpty(const MyElement *e);
 bool MyElement_CAS(MyElement *expected, const MyElement *desired);
+// Table slots: wait for a claim in progress to finish, then report whether the slot is unused
+bool MyElement_isFree(const MyElement *slot);
+// Take an unused slot for desired's key and data. Fails if another thread, or
+// process sharing the table, claimed it first; that one may hold the same key.
+bool MyElement_claim(MyElement *slot, const MyElement *desired);
 
 #endif // MYELEMENT_H
@@ -0,0 +1,207 @@
+#define _DEFAULT_SOURCE  // For syscall
+
+#include "profiler.h"
+#include <linux/perf_event.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_LLC_READ_MISSES,
+    COUNTER_DTLB_READ_MISSES,
+    COUNTER_COUNT
+} Counter;
+
+static const char *phaseNames[PHASE_COUNT] = {"read", "tokenize", "insert", "teardown", "route"};
+static const char *counterNames[COUNTER_COUNT] = {"cycles", "instructions", "llc_read_misses", "dtlb_read_misses"};
+
+typedef struct {
+    uint64_t calls;
+    uint64_t nanos;
+    uint64_t counters[COUNTER_COUNT];
+    uint64_t counted[COUNTER_COUNT];  // Calls that had this counter
+    uint64_t enabled;                 // Time the counter group was enabled and running,
+    uint64_t running;                 // which differ when the PMU was multiplexed
+} PhaseStats;
+
+// Per-thread counter group; the leader is read once to get every member
+typedef struct {
+    bool opened;
+    int fds[COUNTER_COUNT];    // -1 when the counter could not be opened
+    int slot[COUNTER_COUNT];   // Position in the group read
+    int members;
+    struct timespec start;
+    bool startValid;           // Begin read the counters; end only counts a call that has both reads
+    uint64_t startValues[COUNTER_COUNT];
+    uint64_t startEnabled;
+    uint64_t startRunning;
+} ThreadCounters;
+
+// Layout of a group read with the format openCounter asks for
+typedef struct {
+    uint64_t members;
+    uint64_t enabled;
+    uint64_t running;
+    uint64_t values[COUNTER_COUNT];
+} GroupRead;
+
+static bool enabled = false;
+static PhaseStats stats[PROFILE_MAX_WORKERS][PHASE_COUNT];
+static __thread ThreadCounters local;
+
+static int openCounter(uint32_t type, uint64_t config, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;  // Allowed with perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+static uint64_t readMisses(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static void openCounters(void) {
+    local.opened = true;
+    local.members = 0;
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        local.fds[c] = -1;
+    }
+
+    local.fds[COUNTER_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (local.fds[COUNTER_CYCLES] < 0) {
+        return;  // No hardware counters here (VM, container, paranoid setting): timers only
+    }
+    int leader = local.fds[COUNTER_CYCLES];
+    local.fds[COUNTER_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+    // PERF_COUNT_HW_CACHE_MISSES is whatever the PMU calls a cache miss (on many
+    // cores every level); the HW_CACHE event names the last level explicitly
+    local.fds[COUNTER_LLC_READ_MISSES] = openCounter(PERF_TYPE_HW_CACHE, readMisses(PERF_COUNT_HW_CACHE_LL), leader);
+    local.fds[COUNTER_DTLB_READ_MISSES] = openCounter(PERF_TYPE_HW_CACHE, readMisses(PERF_COUNT_HW_CACHE_DTLB), leader);
+
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        local.slot[c] = local.fds[c] >= 0 ? local.members++ : -1;
+    }
+}
+
+// Current values of the open counters and the group's enabled and running
+// times, false if the group read failed
+static bool readCounters(uint64_t *values, uint64_t *enabled, uint64_t *running) {
+    if (local.fds[COUNTER_CYCLES] < 0) {
+        return false;
+    }
+    GroupRead group;
+    ssize_t expected = (ssize_t)(offsetof(GroupRead, values) + local.members * sizeof(uint64_t));
+    if (read(local.fds[COUNTER_CYCLES], &group, sizeof(group)) < expected || group.members != (uint64_t)local.members) {
+        return false;
+    }
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        values[c] = local.slot[c] >= 0 ? group.values[local.slot[c]] : 0;
+    }
+    *enabled = group.enabled;
+    *running = group.running;
+    return true;
+}
+
+void Profiler_enable(void) {
+    enabled = true;
+}
+
+bool Profiler_enabled(void) {
+    return enabled;
+}
+
+void Profiler_begin(int worker, Phase phase) {
+    (void)phase;
+    if (!enabled || worker < 0 || worker >= PROFILE_MAX_WORKERS) {
+        return;
+    }
+    if (!local.opened) {
+        openCounters();
+    }
+    local.startValid = readCounters(local.startValues, &local.startEnabled, &local.startRunning);
+    clock_gettime(CLOCK_MONOTONIC, &local.start);
+}
+
+void Profiler_end(int worker, Phase phase) {
+    if (!enabled || worker < 0 || worker >= PROFILE_MAX_WORKERS) {
+        return;
+    }
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    uint64_t values[COUNTER_COUNT];
+    uint64_t enabled = 0, running = 0;
+    bool counted = local.startValid && readCounters(values, &enabled, &running);
+    if (counted) {
+        enabled -= local.startEnabled;
+        running -= local.startRunning;
+        counted = running > 0;  // Never scheduled on the PMU during this call
+    }
+
+    PhaseStats *s = &stats[worker][phase];
+    s->calls++;
+    s->nanos += (uint64_t)(end.tv_sec - local.start.tv_sec) * 1000000000ULL + (uint64_t)end.tv_nsec -
+                (uint64_t)local.start.tv_nsec;
+    if (!counted) {
+        return;
+    }
+    // When more events are open than the PMU has counters, the kernel time-shares
+    // them and the group only counted for running of the enabled nanoseconds;
+    // scale up to an estimate for the whole call, as perf stat does
+    double scale = (double)enabled / (double)running;
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        if (local.slot[c] >= 0) {
+            s->counters[c] += (uint64_t)((double)(values[c] - local.startValues[c]) * scale + 0.5);
+            s->counted[c]++;
+        }
+    }
+    s->enabled += enabled;
+    s->running += running;
+}
+
+void Profiler_threadDone(void) {
+    if (!local.opened) {
+        return;
+    }
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        if (local.fds[c] >= 0) {
+            close(local.fds[c]);
+        }
+    }
+    local.opened = false;
+}
+
+void Profiler_report(FILE *out) {
+    for (int w = 0; w < PROFILE_MAX_WORKERS; ++w) {
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const PhaseStats *s = &stats[w][p];
+            if (s->calls == 0) {
+                continue;
+            }
+            fprintf(out, "{\"worker\":%d,\"phase\":\"%s\",\"calls\":%llu,\"ns\":%llu", w, phaseNames[p],
+                    (unsigned long long)s->calls, (unsigned long long)s->nanos);
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                // null unless every call of the phase was counted
+                if (s->counted[c] == s->calls) {
+                    fprintf(out, ",\"%s\":%llu", counterNames[c], (unsigned long long)s->counters[c]);
+                } else {
+                    fprintf(out, ",\"%s\":null", counterNames[c]);
+                }
+            }
+            // Fraction of the time the counters were actually counting, 1 unless multiplexed
+            if (s->enabled > 0) {
+                fprintf(out, ",\"counter_running\":%.3f", (double)s->running / (double)s->enabled);
+            }
+            fprintf(out, "}\n");
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Optional per-phase profiling (--profile). Every worker accumulates wall time
+// and, where perf_event_open is permitted, cycles, instructions, last-level cache
+// read misses and dTLB read misses of its own thread per phase, scaled up when
+// the PMU was multiplexed. Disabled, begin/end cost one branch.
+#define PROFILE_MAX_WORKERS 64
+
+typedef enum {
+    PHASE_READ,
+    PHASE_TOKENIZE,
+    PHASE_INSERT,
+    PHASE_TEARDOWN,
+    PHASE_ROUTE,     // DistributedMemoryHashing: hashing tokens into their PE's batch
+    PHASE_COUNT
+} Phase;
+
+void Profiler_enable(void);
+bool Profiler_enabled(void);
+
+// A worker is a stats row, not an OS thread: the main thread also runs a slice
+// of a small streamed chunk. One phase at a time per thread. A thread opens its
+// counters on its first begin, so it should live as long as the phase it measures.
+void Profiler_begin(int worker, Phase phase);
+void Profiler_end(int worker, Phase phase);
+
+// Close the calling thread's counters; call before a profiled thread exits
+void Profiler_threadDone(void);
+
+// One JSON object per line for every worker and phase that ran, so runs can be diffed
+void Profiler_report(FILE *out);
+
+#endif // PROFILER_H
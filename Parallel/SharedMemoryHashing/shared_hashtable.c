@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L  // For shm_open and nanosleep
+
+#include "shared_hashtable.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>  // For error printing
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ATTACH_RETRIES 1000  // 1 ms apart: how long to wait for a creator to finish
+
+// Start of the segment. Only sizes and offsets, never pointers.
+typedef struct {
+    uint32_t magic;      // SHARED_TABLE_MAGIC once the rest is valid
+    uint32_t logSize;
+    uint64_t bytes;      // Whole segment
+    uint64_t mask;
+    uint32_t slotBytes;  // sizeof(MyElement) of the creator
+    uint32_t keyBytes;   // MAX_KEY_LENGTH of the creator
+    char core[8];        // HashTable_coreName of the creator
+} SharedHeader;
+
+_Static_assert(sizeof(SharedHeader) <= SHARED_TABLE_OFFSET, "header must fit before the slots");
+
+static void waitBriefly(void) {
+    struct timespec pause = {0, 1000000};
+    nanosleep(&pause, NULL);
+}
+
+static HashTable *handleFor(void *base) {
+    SharedHeader *header = (SharedHeader *)base;
+    HashTable *ht = (HashTable *)malloc(sizeof(HashTable));
+    if (!ht) {
+        fprintf(stderr, "Memory allocation failed for HashTable.\n");
+        munmap(base, header->bytes);
+        return NULL;
+    }
+    ht->table = (MyElement *)((char *)base + SHARED_TABLE_OFFSET);
+    ht->mask = header->mask;
+    ht->size = header->mask;  // Same convention as HashTable_init
+    ht->filter = NULL;        // A process-local filter would miss other processes' inserts
+    return ht;
+}
+
+static HashTable *create(int fd, size_t logSize) {
+    size_t bytes = SHARED_TABLE_OFFSET + (sizeof(MyElement) << logSize);
+    // The new segment reads as zeros: every slot is already an empty MyElement
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        perror("Could not size shared table");
+        return NULL;
+    }
+    void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("Could not map shared table");
+        return NULL;
+    }
+
+    SharedHeader *header = (SharedHeader *)base;
+    header->logSize = (uint32_t)logSize;
+    header->bytes = bytes;
+    header->mask = (1ULL << logSize) - 1;
+    header->slotBytes = sizeof(MyElement);
+    header->keyBytes = MAX_KEY_LENGTH;
+    strncpy(header->core, HashTable_coreName(), sizeof(header->core) - 1);
+    __atomic_store_n(&header->magic, SHARED_TABLE_MAGIC, __ATOMIC_RELEASE);
+    return handleFor(base);
+}
+
+static HashTable *attach(int fd) {
+    // The creator may still be between shm_open and writing the header
+    struct stat st;
+    int tries = 0;
+    while (fstat(fd, &st) == 0 && (size_t)st.st_size < SHARED_TABLE_OFFSET && tries++ < ATTACH_RETRIES) {
+        waitBriefly();
+    }
+    if ((size_t)st.st_size < SHARED_TABLE_OFFSET) {
+        fprintf(stderr, "Shared table segment was never initialised.\n");
+        return NULL;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("Could not map shared table");
+        return NULL;
+    }
+    SharedHeader *header = (SharedHeader *)base;
+    for (tries = 0; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_TABLE_MAGIC; ++tries) {
+        if (tries == ATTACH_RETRIES) {
+            fprintf(stderr, "Segment is not a shared hash table.\n");
+            munmap(base, (size_t)st.st_size);
+            return NULL;
+        }
+        waitBriefly();
+    }
+    if (header->bytes != (uint64_t)st.st_size) {
+        fprintf(stderr, "Shared table segment has an unexpected size.\n");
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    // Both cores claim slots the same way, but only a table written by one
+    // core is known to follow that core's invariants
+    if (header->slotBytes != sizeof(MyElement) || header->keyBytes != MAX_KEY_LENGTH ||
+        strncmp(header->core, HashTable_coreName(), sizeof(header->core)) != 0) {
+        fprintf(stderr, "Shared table was created by CORE=%.*s with %u-byte slots, this is CORE=%s with %zu-byte slots.\n",
+                (int)sizeof(header->core), header->core, header->slotBytes, HashTable_coreName(), sizeof(MyElement));
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    return handleFor(base);
+}
+
+HashTable *SharedHashTable_open(const char *name, size_t logSize) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    HashTable *ht;
+    if (fd >= 0) {
+        ht = create(fd, logSize);
+        if (!ht) {
+            shm_unlink(name);  // Do not leave a half-made segment for others to attach to
+        }
+    } else if (errno == EEXIST && (fd = shm_open(name, O_RDWR, 0600)) >= 0) {
+        ht = attach(fd);
+    } else {
+        perror("Could not open shared table");
+        return NULL;
+    }
+    close(fd);  // The mapping stays valid without the descriptor
+    return ht;
+}
+
+HashTable *SharedHashTable_attach(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0) {
+        perror("Could not open shared table");
+        return NULL;
+    }
+    HashTable *ht = attach(fd);
+    close(fd);
+    return ht;
+}
+
+void SharedHashTable_close(HashTable *ht) {
+    void *base = (char *)ht->table - SHARED_TABLE_OFFSET;
+    if (ht->filter) {
+        BloomFilter_free(ht->filter);
+    }
+    munmap(base, ((SharedHeader *)base)->bytes);
+    free(ht);
+}
+
+int SharedHashTable_unlink(const char *name) {
+    return shm_unlink(name);
+}
@@ -0,0 +1,32 @@
+#ifndef SHAREDHASHTABLE_H
+#define SHAREDHASHTABLE_H
+
+#include <stddef.h>
+#include "hashtable.h"
+
+// HashTable in a POSIX shared-memory segment, so separate processes (an
+// ingest daemon, query services) work on one table. The segment holds a
+// header and the slot array at fixed offsets and no pointers, so every
+// process may map it at a different address. The handle returned is a
+// process-local HashTable pointing into the mapping: the normal HashTable_*
+// calls work on it, with the same atomic protocols across processes. The
+// creator records its table core and slot layout in the header; a process
+// built differently (other CORE, other MAX_KEY_LENGTH) is refused.
+#define SHARED_TABLE_MAGIC 0x48415348u   // "HASH", written last by the creator
+#define SHARED_TABLE_OFFSET 64           // Slot array starts one cache line in
+
+// Attach to segment `name` (e.g. "/wordcount"), creating it with 2^logSize
+// slots if it does not exist yet. logSize is ignored when attaching.
+HashTable *SharedHashTable_open(const char *name, size_t logSize);
+
+// Attach to an existing segment only, e.g. a snapshot to merge from
+HashTable *SharedHashTable_attach(const char *name);
+
+// Unmap the segment and free the handle; the segment itself stays.
+// Use this instead of HashTable_free on shared handles.
+void SharedHashTable_close(HashTable *ht);
+
+// Remove the segment name; processes still attached keep their mapping
+int SharedHashTable_unlink(const char *name);
+
+#endif // SHAREDHASHTABLE_H
@@ -0,0 +1,151 @@
+#include "sketch.h"
+#include "djb2.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>  // For error printing
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// DJB2 finalised for independent bits
+static uint64_t hash64(const char *str) {
+    return mix64(Djb2_hash(str));
+}
+
+// Counter of row `row` for a key, by double hashing from one 64-bit hash
+static size_t cellIndex(uint64_t h, int row) {
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    return (size_t)row * SKETCH_WIDTH + ((h1 + (uint32_t)row * h2) & (SKETCH_WIDTH - 1));
+}
+
+Sketch *Sketch_init(void) {
+    Sketch *s = (Sketch *)malloc(sizeof(Sketch));
+    if (!s) {
+        fprintf(stderr, "Memory allocation failed for Sketch.\n");
+        return NULL;
+    }
+
+    s->counts = (uint32_t *)aligned_alloc(64, (size_t)SKETCH_DEPTH * SKETCH_WIDTH * sizeof(uint32_t));
+    s->registers = (uint8_t *)aligned_alloc(64, HLL_REGISTERS);
+    if (!s->counts || !s->registers) {
+        free(s->counts);
+        free(s->registers);
+        free(s);
+        fprintf(stderr, "Memory allocation failed for Sketch counters.\n");
+        return NULL;
+    }
+    memset(s->counts, 0, (size_t)SKETCH_DEPTH * SKETCH_WIDTH * sizeof(uint32_t));
+    memset(s->registers, 0, HLL_REGISTERS);
+    return s;
+}
+
+void Sketch_free(Sketch *s) {
+    free(s->counts);
+    free(s->registers);
+    free(s);
+}
+
+// HyperLogLog part of an update
+static void addDistinct(Sketch *s, uint64_t h) {
+    // Top bits pick the register, the rest give the rank
+    uint64_t hll = mix64(h ^ 0x9E3779B97F4A7C15ULL);
+    uint8_t *reg = &s->registers[hll >> (64 - HLL_PRECISION)];
+    uint8_t rank = (uint8_t)(__builtin_clzll((hll << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1))) + 1);
+    uint8_t old = __atomic_load_n(reg, __ATOMIC_RELAXED);
+    while (old < rank && !__atomic_compare_exchange_n(reg, &old, rank, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Thread safe. Conservative update only raises the counters that are below
+// min + count, which keeps the over-estimate much lower than adding to all rows.
+static void addHash(Sketch *s, uint64_t h, uint32_t count) {
+    uint32_t *cells[SKETCH_DEPTH];
+    uint32_t min = UINT32_MAX;
+    for (int row = 0; row < SKETCH_DEPTH; ++row) {
+        cells[row] = &s->counts[cellIndex(h, row)];
+        uint32_t v = __atomic_load_n(cells[row], __ATOMIC_RELAXED);
+        min = v < min ? v : min;
+    }
+    uint32_t target = min > UINT32_MAX - count ? UINT32_MAX : min + count;  // Saturate
+    for (int row = 0; row < SKETCH_DEPTH; ++row) {
+        uint32_t old = __atomic_load_n(cells[row], __ATOMIC_RELAXED);
+        while (old < target &&
+               !__atomic_compare_exchange_n(cells[row], &old, target, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+
+    addDistinct(s, h);
+}
+
+void Sketch_add(Sketch *s, const char *key, uint32_t count) {
+    addHash(s, hash64(key), count);
+}
+
+// hash is the raw DJB2 of the key, as produced by Tokenizer_scan
+void Sketch_addHashed(Sketch *s, size_t hash, uint32_t count) {
+    addHash(s, mix64(hash), count);
+}
+
+// Only feeds the HyperLogLog, for when the number of distinct keys is all
+// that is wanted (table sizing); hash is the raw DJB2 as for Sketch_addHashed
+void Sketch_addDistinct(Sketch *s, size_t hash) {
+    addDistinct(s, mix64(hash));
+}
+
+uint32_t Sketch_estimateCount(const Sketch *s, const char *key) {
+    uint64_t h = hash64(key);
+    uint32_t min = UINT32_MAX;
+    for (int row = 0; row < SKETCH_DEPTH; ++row) {
+        uint32_t v = __atomic_load_n(&s->counts[cellIndex(h, row)], __ATOMIC_RELAXED);
+        min = v < min ? v : min;
+    }
+    return min;
+}
+
+double Sketch_estimateDistinct(const Sketch *s) {
+    double m = HLL_REGISTERS;
+    double sum = 0.0;
+    int zeros = 0;
+    for (size_t j = 0; j < HLL_REGISTERS; ++j) {
+        uint8_t r = __atomic_load_n(&s->registers[j], __ATOMIC_RELAXED);
+        sum += ldexp(1.0, -r);
+        zeros += r == 0;
+    }
+
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log(m / zeros);  // Linear counting for small cardinalities
+    }
+    return estimate;
+}
+
+// Fold `from` into `into` (per-thread or per-PE sketches). Both must be
+// quiescent; the loops are plain element-wise add/max so they vectorise.
+void Sketch_merge(Sketch *into, const Sketch *from) {
+    uint32_t *restrict dst = into->counts;
+    const uint32_t *restrict src = from->counts;
+    for (size_t i = 0; i < (size_t)SKETCH_DEPTH * SKETCH_WIDTH; ++i) {
+        uint32_t sum = dst[i] + src[i];
+        dst[i] = sum < dst[i] ? UINT32_MAX : sum;  // Saturate
+    }
+
+    uint8_t *restrict regDst = into->registers;
+    const uint8_t *restrict regSrc = from->registers;
+    for (size_t j = 0; j < HLL_REGISTERS; ++j) {
+        regDst[j] = regSrc[j] > regDst[j] ? regSrc[j] : regDst[j];
+    }
+}
+
+size_t Sketch_bytes(void) {
+    return (size_t)SKETCH_DEPTH * SKETCH_WIDTH * sizeof(uint32_t) + HLL_REGISTERS;
+}
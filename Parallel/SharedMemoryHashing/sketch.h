@@ -0,0 +1,36 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-memory approximate counting: a Count-Min sketch with conservative
+// update for frequencies and a HyperLogLog for the number of distinct keys.
+//
+// Error bounds for N = total count added:
+//   Count-Min: estimate >= true count, and estimate <= true count + (e / SKETCH_WIDTH) * N
+//              (about 1.04e-5 * N) with probability 1 - e^-SKETCH_DEPTH (about 98%).
+//   HyperLogLog: standard error 1.04 / sqrt(HLL_REGISTERS), about 0.81%.
+// Memory: SKETCH_DEPTH * SKETCH_WIDTH * 4 bytes (4 MB) + HLL_REGISTERS bytes (16 KB).
+#define SKETCH_DEPTH 4
+#define SKETCH_LOG_WIDTH 18
+#define SKETCH_WIDTH (1u << SKETCH_LOG_WIDTH)
+#define HLL_PRECISION 14
+#define HLL_REGISTERS (1u << HLL_PRECISION)
+
+typedef struct {
+    uint32_t *counts;    // SKETCH_DEPTH rows of SKETCH_WIDTH counters, row-major, 64-byte aligned
+    uint8_t *registers;  // HLL_REGISTERS HyperLogLog registers
+} Sketch;
+
+Sketch *Sketch_init(void);
+void Sketch_free(Sketch *s);
+void Sketch_add(Sketch *s, const char *key, uint32_t count);
+void Sketch_addHashed(Sketch *s, size_t hash, uint32_t count);
+void Sketch_addDistinct(Sketch *s, size_t hash);
+uint32_t Sketch_estimateCount(const Sketch *s, const char *key);
+double Sketch_estimateDistinct(const Sketch *s);
+void Sketch_merge(Sketch *into, const Sketch *from);
+size_t Sketch_bytes(void);
+
+#endif // SKETCH_H
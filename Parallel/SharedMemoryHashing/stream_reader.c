@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 200809L // For read/open
+#include "stream_reader.h"
+#include <fcntl.h>
+#include <stdio.h>   // For error printing
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+StreamReader *StreamReader_open(const char *path) {
+    StreamReader *r = (StreamReader *)malloc(sizeof(StreamReader));
+    if (!r) {
+        fprintf(stderr, "Memory allocation failed for StreamReader.\n");
+        return NULL;
+    }
+
+    r->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    r->buffer = (char *)malloc(STREAM_CHUNK_SIZE + 1);
+    if (r->fd < 0 || !r->buffer) {
+        perror("Could not open stream");
+        if (r->fd > STDIN_FILENO) close(r->fd);
+        free(r->buffer);
+        free(r);
+        return NULL;
+    }
+    r->tail = 0;
+    r->tailLength = 0;
+    r->eof = false;
+    return r;
+}
+
+void StreamReader_close(StreamReader *r) {
+    if (r->fd != STDIN_FILENO) {
+        close(r->fd);
+    }
+    free(r->buffer);
+    free(r);
+}
+
+// Return the next NUL-terminated chunk, cut at the last delimiter so no token
+// is split. read() returns whatever a pipe has, so data is handed on as it
+// arrives instead of waiting for a full chunk. Returns NULL at end of input.
+char *StreamReader_next(StreamReader *r, size_t *length) {
+    memmove(r->buffer, r->buffer + r->tail, r->tailLength);
+    size_t filled = r->tailLength;
+    r->tail = 0;
+    r->tailLength = 0;
+
+    while (!r->eof && filled < STREAM_CHUNK_SIZE) {
+        ssize_t n = read(r->fd, r->buffer + filled, STREAM_CHUNK_SIZE - filled);
+        if (n <= 0) {
+            if (n < 0) perror("Stream read failed");
+            r->eof = true;
+            break;
+        }
+        filled += (size_t)n;
+        if (memchr(r->buffer + filled - n, '\n', n)) {
+            break;  // A complete line arrived, process it now
+        }
+    }
+    if (filled == 0) {
+        return NULL;
+    }
+
+    size_t cut = filled;
+    if (!r->eof) {
+        while (cut > 0 && !strchr(TOKEN_DELIMITERS, r->buffer[cut - 1])) {
+            cut--;
+        }
+        if (cut == 0) {
+            cut = filled;  // One token fills the whole chunk, hand it on as is
+        } else {
+            r->tail = cut;
+            r->tailLength = filled - cut;
+        }
+    }
+
+    if (cut == filled) {
+        r->buffer[filled] = '\0';
+        *length = filled;
+    } else {
+        r->buffer[cut - 1] = '\0';  // Overwrites a delimiter, the tail stays intact
+        *length = cut - 1;
+    }
+    return r->buffer;
+}
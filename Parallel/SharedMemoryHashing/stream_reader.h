@@ -0,0 +1,22 @@
+#ifndef STREAMREADER_H
+#define STREAMREADER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define STREAM_CHUNK_SIZE (1 << 20)  // Bytes read per chunk
+#define TOKEN_DELIMITERS " ,.-\n"
+
+typedef struct {
+    int fd;
+    char *buffer;       // STREAM_CHUNK_SIZE + 1 bytes
+    size_t tail;        // Start of the partial token carried into the next chunk
+    size_t tailLength;
+    bool eof;
+} StreamReader;
+
+StreamReader *StreamReader_open(const char *path);  // "-" reads stdin
+void StreamReader_close(StreamReader *r);
+char *StreamReader_next(StreamReader *r, size_t *length);
+
+#endif // STREAMREADER_H
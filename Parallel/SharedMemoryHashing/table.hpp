@@ -0,0 +1,230 @@
+#ifndef TABLE_HPP
+#define TABLE_HPP
+
+// Header-only C++ core of the concurrent linear-probing table. Key, value,
+// hash and update policy are template parameters, so every combination gets
+// its own probe loop: integer keys compare with a single instruction in
+// 16-byte slots, and the update policy is inlined instead of dispatched.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "djb2.h"
+#include "my_element.h"  // For MAX_KEY_LENGTH
+
+namespace hashing {
+
+// Update policies, the C++ counterparts of the dummy structs in atomic_update.h
+struct Overwrite {
+    template <typename V>
+    static void apply(V *slot, V value) { __atomic_store_n(slot, value, __ATOMIC_RELAXED); }
+};
+
+struct Increment {
+    template <typename V>
+    static void apply(V *slot, V) { __atomic_fetch_add(slot, 1, __ATOMIC_RELAXED); }
+};
+
+struct Decrement {
+    template <typename V>
+    static void apply(V *slot, V) { __atomic_fetch_sub(slot, 1, __ATOMIC_RELAXED); }
+};
+
+struct Add {
+    template <typename V>
+    static void apply(V *slot, V value) { __atomic_fetch_add(slot, value, __ATOMIC_RELAXED); }
+};
+
+// The shared DJB2, so both cores place keys the same way
+struct Djb2Hash {
+    size_t operator()(const char *str) const { return Djb2_hash(str); }
+};
+
+// 64-bit finaliser for integer keys, whose low bits are often not random
+struct MixHash {
+    size_t operator()(uint64_t key) const {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+};
+
+enum class Probe { Match, Empty, Other };
+
+template <typename Key, typename Value>
+struct Slot;
+
+// Integer keys: 16-byte slot, the key word itself is the claim state. A
+// claimer parks kBusy in it, writes the value, then publishes the key, so a
+// matching key is never seen before its value.
+template <typename Value>
+struct Slot<uint64_t, Value> {
+    static constexpr uint64_t kEmpty = ~0ULL;     // Reserved keys, can be neither stored nor found
+    static constexpr uint64_t kBusy = ~0ULL - 1;
+
+    uint64_t key;
+    Value value;
+
+    static bool storable(uint64_t k) { return k != kEmpty && k != kBusy; }
+
+    void init() {
+        key = kEmpty;
+        value = 0;
+    }
+
+    Probe probe(uint64_t k) const {
+        uint64_t current;
+        while ((current = __atomic_load_n(&key, __ATOMIC_ACQUIRE)) == kBusy) {
+            // Another thread is still writing its value
+        }
+        return current == k ? Probe::Match : current == kEmpty ? Probe::Empty : Probe::Other;
+    }
+
+    bool tryClaim(uint64_t k, Value v) {
+        uint64_t expected = kEmpty;
+        if (!__atomic_compare_exchange_n(&key, &expected, kBusy, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return false;
+        }
+        __atomic_store_n(&value, v, __ATOMIC_RELAXED);
+        __atomic_store_n(&key, k, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+// String keys: same layout as MyElement, with the claim state living in the
+// padding between key and data, so a MyElement array can be used directly
+template <typename Value>
+struct Slot<const char *, Value> {
+    enum : uint32_t { kEmpty = 0, kBusy = 1, kReady = 2 };
+
+    char key[MAX_KEY_LENGTH];
+    uint32_t state;
+    Value value;
+
+    static bool storable(const char *) { return true; }
+
+    void init() { std::memset(this, 0, sizeof(*this)); }
+
+    Probe probe(const char *k) const {
+        uint32_t s;
+        while ((s = __atomic_load_n(&state, __ATOMIC_ACQUIRE)) == kBusy) {
+            // Another thread is still copying its key in
+        }
+        if (s == kEmpty) {
+            return Probe::Empty;
+        }
+        return std::strncmp(key, k, MAX_KEY_LENGTH) == 0 ? Probe::Match : Probe::Other;
+    }
+
+    bool tryClaim(const char *k, Value v) {
+        uint32_t expected = kEmpty;
+        if (!__atomic_compare_exchange_n(&state, &expected, kBusy, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return false;
+        }
+        std::strncpy(key, k, MAX_KEY_LENGTH - 1);
+        key[MAX_KEY_LENGTH - 1] = '\0';
+        value = v;
+        __atomic_store_n(&state, static_cast<uint32_t>(kReady), __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+template <typename Key, typename Value, typename Hash, typename UpdatePolicy = Increment, size_t MaxDist = 100>
+class Table {
+public:
+    using SlotType = Slot<Key, Value>;
+
+    // Owning table with 2^logSize slots
+    explicit Table(size_t logSize)
+        : slots_(static_cast<SlotType *>(std::aligned_alloc(64, sizeof(SlotType) << logSize))),
+          mask_((size_t(1) << logSize) - 1),
+          owned_(true) {
+        if (slots_) {
+            for (size_t i = 0; i <= mask_; ++i) {
+                slots_[i].init();
+            }
+        }
+    }
+
+    // View over slots owned by someone else, e.g. the C HashTable
+    Table(SlotType *slots, size_t mask) : slots_(slots), mask_(mask), owned_(false) {}
+
+    ~Table() {
+        if (owned_) {
+            std::free(slots_);
+        }
+    }
+
+    Table(const Table &) = delete;
+    Table &operator=(const Table &) = delete;
+
+    bool valid() const { return slots_ != nullptr; }
+
+    // Insert key with value, or apply Policy to the stored value if present.
+    // Returns false when MaxDist slots were probed without success, or for
+    // a key the slot reserves as its empty or busy marker.
+    template <typename Policy = UpdatePolicy>
+    bool insertOrUpdate(Key key, Value value) {
+        return insertOrUpdateHashed<Policy>(key, Hash{}(key), value);
+    }
+
+    // Same, with h = Hash{}(key) already computed by the caller
+    template <typename Policy = UpdatePolicy>
+    bool insertOrUpdateHashed(Key key, size_t h, Value value) {
+        if (!SlotType::storable(key)) {
+            return false;  // Would match every empty or half-claimed slot
+        }
+        for (size_t i = h; i < h + MaxDist; ++i) {
+            SlotType &slot = slots_[i & mask_];
+            switch (slot.probe(key)) {
+                case Probe::Match:
+                    Policy::apply(&slot.value, value);
+                    return true;
+                case Probe::Empty:
+                    if (slot.tryClaim(key, value)) {
+                        return true;
+                    }
+                    --i;  // Lost the claim; the winner may have inserted this key
+                    break;
+                case Probe::Other:
+                    break;
+            }
+        }
+        return false;
+    }
+
+    bool find(Key key, Value &out) const {
+        if (!SlotType::storable(key)) {
+            return false;
+        }
+        size_t h = Hash{}(key);
+        for (size_t i = h; i < h + MaxDist; ++i) {
+            const SlotType &slot = slots_[i & mask_];
+            switch (slot.probe(key)) {
+                case Probe::Match:
+                    out = __atomic_load_n(&slot.value, __ATOMIC_RELAXED);
+                    return true;
+                case Probe::Empty:
+                    return false;
+                case Probe::Other:
+                    break;
+            }
+        }
+        return false;
+    }
+
+    SlotType *slots() { return slots_; }
+    size_t mask() const { return mask_; }
+
+private:
+    SlotType *slots_;
+    size_t mask_;
+    bool owned_;
+};
+
+}  // namespace hashing
+
+#endif  // TABLE_HPP
@@ -0,0 +1,106 @@
+// make check: the integer-key path of table.hpp, which the C ABI never
+// instantiates. Writers race to claim the same keys while readers look them
+// up; a key must never be seen before its value, nor counted twice.
+
+#include <cstdio>
+#include <pthread.h>
+
+#include "table.hpp"
+
+using IntTable = hashing::Table<uint64_t, long long, hashing::MixHash, hashing::Add>;
+
+static const int kWriters = 4;
+static const uint64_t kKeys = 1 << 16;
+static const long long kValue = 7;  // Never 0, so a reader seeing 0 caught a half-claimed slot
+
+static IntTable table(18);
+static int writersDone = 0;
+static long long zeroReads = 0;
+
+static void *writer(void *) {
+    for (uint64_t k = 0; k < kKeys; ++k) {
+        table.insertOrUpdate(k, kValue);
+    }
+    __atomic_fetch_add(&writersDone, 1, __ATOMIC_RELEASE);
+    return nullptr;
+}
+
+static void *reader(void *) {
+    while (__atomic_load_n(&writersDone, __ATOMIC_ACQUIRE) < kWriters) {
+        for (uint64_t k = 0; k < kKeys; k += 61) {
+            long long v = 0;
+            if (table.find(k, v) && v == 0) {
+                __atomic_fetch_add(&zeroReads, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Overwrite racing the first insert must leave exactly the written value
+static bool checkOverwrite() {
+    IntTable overwritten(10);
+    pthread_t threads[2];
+    struct Args {
+        IntTable *t;
+        long long v = 0;
+    } args[2] = {{&overwritten, 5}, {&overwritten, 5}};
+    auto run = [](void *p) -> void * {
+        Args *a = static_cast<Args *>(p);
+        for (uint64_t k = 0; k < 512; ++k) {
+            a->t->insertOrUpdate<hashing::Overwrite>(k, a->v);
+        }
+        return nullptr;
+    };
+    for (Args &a : args) {
+        pthread_create(&threads[&a - args], nullptr, run, &a);
+    }
+    for (pthread_t &t : threads) {
+        pthread_join(t, nullptr);
+    }
+    for (uint64_t k = 0; k < 512; ++k) {
+        long long v = 0;
+        if (!overwritten.find(k, v) || v != 5) {
+            std::printf("key %llu holds %lld after overwrites of 5\n", (unsigned long long)k, v);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    if (!table.valid()) {
+        return 1;
+    }
+    pthread_t writers[kWriters], readers[2];
+    for (pthread_t &t : readers) {
+        pthread_create(&t, nullptr, reader, nullptr);
+    }
+    for (pthread_t &t : writers) {
+        pthread_create(&t, nullptr, writer, nullptr);
+    }
+    for (pthread_t &t : writers) {
+        pthread_join(t, nullptr);
+    }
+    for (pthread_t &t : readers) {
+        pthread_join(t, nullptr);
+    }
+
+    bool ok = zeroReads == 0 && checkOverwrite();
+    for (uint64_t k = 0; ok && k < kKeys; ++k) {
+        long long v = 0;
+        if (!table.find(k, v) || v != kWriters * kValue) {
+            std::printf("key %llu holds %lld, expected %lld\n", (unsigned long long)k, v, kWriters * kValue);
+            ok = false;
+        }
+    }
+    uint64_t reserved[] = {hashing::Slot<uint64_t, long long>::kEmpty, hashing::Slot<uint64_t, long long>::kBusy};
+    for (uint64_t k : reserved) {
+        ok = ok && !table.insertOrUpdate(k, 1);
+    }
+    if (zeroReads > 0) {
+        std::printf("%lld lookups saw a key before its value\n", zeroReads);
+    }
+    std::printf(ok ? "integer table check passed\n" : "integer table check failed\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#define _POSIX_C_SOURCE 200809L  // For sysconf
+
+#include "table_sizing.h"
+#include "sketch.h"
+#include "stream_reader.h"
+#include "tokenizer.h"
+#include "djb2.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SAMPLE_TOKEN_BATCH 256
+
+// Smallest table that keeps the estimated keys at AUTO_TARGET_LOAD even if
+// the HyperLogLog came out AUTO_ERROR_MARGIN standard errors low, and as
+// many threads as there are cores and enough words to keep them busy
+static void choose(TableSizing *sizing, int maxThreads) {
+    double keys = sizing->distinct * (1.0 + AUTO_ERROR_MARGIN * 1.04 / sqrt(HLL_REGISTERS));
+    sizing->logSize = AUTO_MIN_LOG_SIZE;
+    while (sizing->logSize < AUTO_MAX_LOG_SIZE && (double)(1ULL << sizing->logSize) * AUTO_TARGET_LOAD < keys) {
+        sizing->logSize++;
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    double useful = sizing->words / AUTO_WORDS_PER_THREAD;
+    int threads = maxThreads;
+    if (cores > 0 && cores < threads) {
+        threads = (int)cores;
+    }
+    if (useful < threads) {
+        threads = (int)useful;
+    }
+    sizing->threads = threads > 0 ? threads : 1;
+}
+
+TableSizing TableSizing_fromWords(char **words, int count, int maxThreads) {
+    TableSizing sizing = {0};
+    Sketch *sketch = Sketch_init();
+    if (sketch) {
+        for (int i = 0; i < count; ++i) {
+            Sketch_addDistinct(sketch, Djb2_hash(words[i]));
+        }
+        sizing.distinct = Sketch_estimateDistinct(sketch);
+        Sketch_free(sketch);
+    } else {
+        sizing.distinct = count;  // Worst case: every word is different
+    }
+    sizing.words = count;
+    choose(&sizing, maxThreads);
+    return sizing;
+}
+
+bool TableSizing_fromFile(const char *path, int maxThreads, TableSizing *sizing) {
+    struct stat st;
+    if (strcmp(path, "-") == 0 || stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;  // A pipe cannot be read twice
+    }
+    StreamReader *reader = StreamReader_open(path);
+    Sketch *sketch = Sketch_init();
+    if (!reader || !sketch) {
+        if (reader) {
+            StreamReader_close(reader);
+        }
+        if (sketch) {
+            Sketch_free(sketch);
+        }
+        return false;
+    }
+
+    Token tokens[SAMPLE_TOKEN_BATCH];
+    size_t sampledBytes = 0;
+    double sampledWords = 0;
+    size_t halfBytes = 0;  // Where the first half of the sample ended
+    double halfDistinct = 0;
+    size_t length;
+    char *chunk;
+    while (sampledBytes < AUTO_SAMPLE_BYTES && (chunk = StreamReader_next(reader, &length)) != NULL) {
+        if (halfBytes == 0 && sampledBytes >= AUTO_SAMPLE_BYTES / 2) {
+            halfBytes = sampledBytes;
+            halfDistinct = Sketch_estimateDistinct(sketch);
+        }
+        sampledBytes += length + 1;  // Plus the delimiter the reader cut at
+        while (length > 0) {
+            size_t consumed;
+            size_t count = Tokenizer_scan(chunk, length, tokens, SAMPLE_TOKEN_BATCH, &consumed);
+            for (size_t i = 0; i < count; ++i) {
+                Sketch_addDistinct(sketch, tokens[i].hash);
+            }
+            sampledWords += count;
+            chunk += consumed;
+            length -= consumed;
+        }
+    }
+    StreamReader_close(reader);
+
+    *sizing = (TableSizing){0};
+    sizing->distinct = Sketch_estimateDistinct(sketch);
+    sizing->words = sampledWords;
+    Sketch_free(sketch);
+
+    if (sampledBytes < (size_t)st.st_size) {
+        double scale = (double)st.st_size / (double)sampledBytes;
+        // Heaps' law only holds for natural text: IDs, URLs or hashes keep
+        // adding new keys almost linearly. Measure the growth over the
+        // sample's second half and scale with whichever is faster.
+        sizing->exponent = HEAPS_EXPONENT;
+        if (halfBytes > 0 && halfDistinct > 0 && sizing->distinct > halfDistinct) {
+            double measured = log(sizing->distinct / halfDistinct) / log((double)sampledBytes / (double)halfBytes);
+            if (measured > sizing->exponent) {
+                sizing->exponent = measured < 1.0 ? measured : 1.0;
+            }
+        }
+        sizing->sampled = true;
+        sizing->distinct *= pow(scale, sizing->exponent);
+        sizing->words *= scale;
+        if (sizing->distinct > sizing->words) {
+            sizing->distinct = sizing->words;  // Every word distinct is the most there can be
+        }
+    }
+    choose(sizing, maxThreads);
+    return true;
+}
+
+void TableSizing_print(const TableSizing *sizing) {
+    if (sizing->sampled) {
+        printf("Auto-size: ~%.0f distinct keys (scaled from a sample by size^%.2f)", sizing->distinct,
+               sizing->exponent);
+    } else {
+        printf("Auto-size: ~%.0f distinct keys (counted)", sizing->distinct);
+    }
+    printf(", %zu slots at %.0f%% target load, %d threads\n", (size_t)1 << sizing->logSize,
+           AUTO_TARGET_LOAD * 100, sizing->threads);
+}
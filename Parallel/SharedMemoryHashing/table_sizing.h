@@ -0,0 +1,40 @@
+#ifndef TABLESIZING_H
+#define TABLESIZING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Auto-sizing (--auto-size): estimate the number of distinct keys with the
+// sketch's HyperLogLog and pick the table size and thread count from it,
+// instead of the fixed 2^24 slots and NUM_THREADS threads.
+#define AUTO_TARGET_LOAD 0.5           // Linear probing with MAX_DIST stays short below this
+#define AUTO_ERROR_MARGIN 3            // HyperLogLog standard errors of headroom; a streamed table
+                                       // the sampled estimate still left too small is rebuilt
+#define AUTO_MIN_LOG_SIZE 10
+#define AUTO_MAX_LOG_SIZE 24           // Never more than the fixed default
+#define AUTO_SAMPLE_BYTES (16 << 20)   // Prefix of a file read by the sampling pass
+#define AUTO_WORDS_PER_THREAD 65536    // Fewer words than this are not worth another thread
+#define HEAPS_EXPONENT 0.6             // Vocabulary grows like size^0.6 in natural text (Heaps' law),
+                                       // the least growth a sampled estimate assumes
+
+typedef struct {
+    double distinct;     // Estimated distinct keys in the whole input
+    double words;        // Estimated words in the whole input
+    bool sampled;        // Scaled up from a prefix rather than counted over everything
+    double exponent;     // Growth exponent the sample was scaled with
+    size_t logSize;      // Chosen table size: 2^logSize slots
+    int threads;         // Chosen number of insert threads
+} TableSizing;
+
+// Over words already in memory: every word is counted, nothing is scaled
+TableSizing TableSizing_fromWords(char **words, int count, int maxThreads);
+
+// Sampling pass over the first AUTO_SAMPLE_BYTES of a file; the estimate is
+// scaled to the file size by how fast distinct keys grew over the sample's
+// second half, never slower than HEAPS_EXPONENT and never past the word count.
+// Returns false for stdin or an unreadable path.
+bool TableSizing_fromFile(const char *path, int maxThreads, TableSizing *sizing);
+
+void TableSizing_print(const TableSizing *sizing);
+
+#endif // TABLESIZING_H
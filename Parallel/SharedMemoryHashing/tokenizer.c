@@ -0,0 +1,118 @@
+#include "tokenizer.h"
+#include "stream_reader.h"  // For TOKEN_DELIMITERS
+#include "djb2.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BLOCK_SIZE 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_SIZE 16
+#else
+#define BLOCK_SIZE 32
+#endif
+
+typedef uint32_t BlockMask;  // Bit i set when byte i of the block is a delimiter
+
+static bool isDelimiter(char c) {
+    return c != '\0' && strchr(TOKEN_DELIMITERS, c) != NULL;
+}
+
+// Delimiter mask of a short block, bytes past n count as delimiters
+static BlockMask scalarMask(const char *p, size_t n) {
+    BlockMask mask = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        if (i >= n || isDelimiter(p[i])) {
+            mask |= (BlockMask)1 << i;
+        }
+    }
+    return mask;
+}
+
+// Delimiter mask of a full block: one compare per delimiter, OR-ed together.
+// The compares spell out TOKEN_DELIMITERS and must be kept in sync with it.
+static BlockMask blockMask(const char *p) {
+#if defined(__AVX2__)
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                                  _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(',')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('.')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('-')));
+    hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')));
+    return (BlockMask)_mm256_movemask_epi8(hit);
+#elif defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                               _mm_cmpeq_epi8(bytes, _mm_set1_epi8(',')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('.')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('-')));
+    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+    return (BlockMask)_mm_movemask_epi8(hit);
+#else
+    return scalarMask(p, BLOCK_SIZE);
+#endif
+}
+
+// Lowest set bit at or above bit `from`, BLOCK_SIZE if there is none
+static size_t nextBit(BlockMask mask, size_t from) {
+    mask = from < BLOCK_SIZE ? mask & ~(((BlockMask)1 << from) - 1) : 0;
+    return mask ? (size_t)__builtin_ctz(mask) : BLOCK_SIZE;
+}
+
+size_t Tokenizer_scan(char *text, size_t length, Token *tokens, size_t maxTokens, size_t *consumed) {
+    size_t count = 0;
+    size_t start = 0;     // Offset of the token being built
+    size_t hash = DJB2_SEED;  // DJB2 state of that token
+    bool inToken = false;
+
+    *consumed = 0;
+    if (maxTokens == 0) {
+        return 0;
+    }
+    for (size_t block = 0; block < length && count < maxTokens; block += BLOCK_SIZE) {
+        size_t n = length - block < BLOCK_SIZE ? length - block : BLOCK_SIZE;
+        BlockMask delimiters = n == BLOCK_SIZE ? blockMask(text + block) : scalarMask(text + block, n);
+        size_t pos = 0;
+
+        while (pos < n) {
+            if (!inToken) {
+                pos = nextBit(~delimiters, pos);  // Skip delimiter runs
+                if (pos >= n) {
+                    break;
+                }
+                inToken = true;
+                start = block + pos;
+                hash = DJB2_SEED;
+            }
+
+            // Hash up to the next delimiter while the block is still in L1
+            size_t end = nextBit(delimiters, pos);
+            if (end > n) {
+                end = n;
+            }
+            for (const char *p = text + block + pos; p < text + block + end; ++p) {
+                hash = Djb2_step(hash, *p);
+            }
+            pos = end;
+
+            if (pos < n) {
+                text[block + pos] = '\0';
+                tokens[count++] = (Token){(uint32_t)start, (uint32_t)(block + pos - start), hash};
+                inToken = false;
+                *consumed = block + pos + 1;
+                if (count == maxTokens) {
+                    return count;
+                }
+            }
+        }
+    }
+
+    if (inToken) {
+        text[length] = '\0';  // Last token runs to the end of the text
+        tokens[count++] = (Token){(uint32_t)start, (uint32_t)(length - start), hash};
+    }
+    *consumed = length;
+    return count;
+}
@@ -0,0 +1,26 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One token of a scanned buffer. hash is Djb2_hash of the token bytes, the
+// same value hashtable.c computes before masking, so inserts can skip
+// hashing the key a second time.
+typedef struct {
+    uint32_t offset;  // From the start of the scanned text
+    uint32_t length;
+    size_t hash;
+} Token;
+
+// Split text at TOKEN_DELIMITERS and hash every token in the same pass.
+// Delimiters are found a vector block at a time (AVX2 when built with
+// make SIMD=avx2, SSE2 otherwise on x86, plain C elsewhere). Each token is
+// NUL-terminated in place, so text[length] must be writable; text + offset
+// is then a C string.
+//
+// Stops after maxTokens tokens. *consumed is set to the number of bytes
+// fully processed; call again on text + *consumed to continue.
+size_t Tokenizer_scan(char *text, size_t length, Token *tokens, size_t maxTokens, size_t *consumed);
+
+#endif // TOKENIZER_H
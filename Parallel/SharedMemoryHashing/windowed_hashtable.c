@@ -0,0 +1,161 @@
+#include "windowed_hashtable.h"
+#include "hashtable.h"  // For MAX_DIST
+#include "djb2.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>  // For error printing
+
+#define SLOT_EMPTY 0
+#define SLOT_BUSY 1   // Claimed, key still being copied
+#define SLOT_READY 2
+
+static size_t hash(const char *str, size_t mask) {
+    return Djb2_hash(str) & mask;
+}
+
+static uint32_t cellEpoch(uint64_t cell) {
+    return (uint32_t)(cell >> 32);
+}
+
+static uint32_t cellCount(uint64_t cell) {
+    return (uint32_t)cell;
+}
+
+// Clamp an element's data to what a cell can hold instead of truncating it
+static uint32_t cellDelta(long long data) {
+    if (data <= 0) {
+        return 0;
+    }
+    return data >= UINT32_MAX ? UINT32_MAX : (uint32_t)data;
+}
+
+// Wait for a slot claimed by another thread to get its key
+static uint32_t readyState(WindowSlot *slot) {
+    uint32_t state;
+    while ((state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) == SLOT_BUSY) {
+    }
+    return state;
+}
+
+WindowedHashTable *WindowedHashTable_init(size_t logSize) {
+    WindowedHashTable *ht = (WindowedHashTable *)malloc(sizeof(WindowedHashTable));
+    if (!ht) {
+        fprintf(stderr, "Memory allocation failed for WindowedHashTable.\n");
+        return NULL;
+    }
+
+    ht->size = (1ULL << logSize) - 1;
+    ht->mask = ht->size;
+    ht->epoch = 0;
+    ht->table = (WindowSlot *)calloc(ht->size + 1, sizeof(WindowSlot));  // All slots SLOT_EMPTY
+    if (!ht->table) {
+        free(ht);
+        fprintf(stderr, "Memory allocation failed for WindowedHashTable table.\n");
+        return NULL;
+    }
+    return ht;
+}
+
+void WindowedHashTable_free(WindowedHashTable *ht) {
+    free(ht->table);
+    free(ht);
+}
+
+// Start a new epoch in O(1); the cells it reuses are reset lazily on write
+uint32_t WindowedHashTable_advanceEpoch(WindowedHashTable *ht) {
+    return __atomic_add_fetch(&ht->epoch, 1, __ATOMIC_RELEASE);
+}
+
+// Add delta to the key's count in the current epoch
+static void addToEpoch(WindowedHashTable *ht, WindowSlot *slot, uint32_t delta) {
+    uint32_t epoch = __atomic_load_n(&ht->epoch, __ATOMIC_ACQUIRE);
+    uint64_t *cell = &slot->cells[epoch % WINDOW_EPOCHS];
+
+    while (true) {
+        uint64_t old = __atomic_load_n(cell, __ATOMIC_RELAXED);
+        uint64_t desired;
+        if (cellEpoch(old) == epoch) {
+            // Saturate: a carry out of the count would turn the tag into a future epoch
+            uint32_t room = UINT32_MAX - cellCount(old);
+            if (room == 0) {
+                return;
+            }
+            desired = old + (delta < room ? delta : room);
+        } else if (cellEpoch(old) < epoch) {
+            desired = ((uint64_t)epoch << 32) | delta;  // Expired epoch, drop its count
+        } else {
+            // The ring wrapped past our epoch while we were running; use the new one
+            epoch = __atomic_load_n(&ht->epoch, __ATOMIC_ACQUIRE);
+            cell = &slot->cells[epoch % WINDOW_EPOCHS];
+            continue;
+        }
+        if (__atomic_compare_exchange_n(cell, &old, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+bool WindowedHashTable_insertOrUpdateIncrement(WindowedHashTable *ht, const MyElement *e, Increment f) {
+    (void)f;
+    size_t h = hash(e->key, ht->mask);
+
+    for (size_t i = h; i < h + MAX_DIST; ++i) {
+        WindowSlot *current = &ht->table[i & ht->mask];
+        uint32_t state = readyState(current);
+
+        if (state == SLOT_EMPTY) {
+            uint32_t expected = SLOT_EMPTY;
+            if (!__atomic_compare_exchange_n(&current->state, &expected, SLOT_BUSY, false,
+                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                i--;  // Lost the race for this slot; look at it again
+                continue;
+            }
+            memcpy(current->key, e->key, MAX_KEY_LENGTH);
+            __atomic_store_n(&current->state, SLOT_READY, __ATOMIC_RELEASE);
+            addToEpoch(ht, current, cellDelta(e->data));
+            return true;
+        }
+
+        if (strcmp(current->key, e->key) == 0) {
+            addToEpoch(ht, current, cellDelta(e->data));
+            return true;
+        }
+    }
+
+    return false;  // Table is full or max probing distance exceeded
+}
+
+// Sum of the key's counts over the last `epochs` epochs, the current one included
+long long WindowedHashTable_findWindow(WindowedHashTable *ht, const char *key, uint32_t epochs) {
+    if (epochs > WINDOW_EPOCHS) {
+        epochs = WINDOW_EPOCHS;
+    }
+    size_t h = hash(key, ht->mask);
+
+    for (size_t i = h; i < h + MAX_DIST; ++i) {
+        WindowSlot *current = &ht->table[i & ht->mask];
+        if (readyState(current) == SLOT_EMPTY) {
+            break;
+        }
+        if (strcmp(current->key, key) != 0) {
+            continue;
+        }
+
+        uint32_t epoch = __atomic_load_n(&ht->epoch, __ATOMIC_ACQUIRE);
+        long long total = 0;
+        for (int c = 0; c < WINDOW_EPOCHS; ++c) {
+            uint64_t cell = __atomic_load_n(&current->cells[c], __ATOMIC_RELAXED);
+            if (cellEpoch(cell) <= epoch && epoch - cellEpoch(cell) < epochs) {
+                total += cellCount(cell);
+            }
+        }
+        return total;
+    }
+    return 0;
+}
+
+// Same shape as HashTable_find, with data set to the count over the whole ring
+MyElement WindowedHashTable_find(WindowedHashTable *ht, const char *key) {
+    long long total = WindowedHashTable_findWindow(ht, key, WINDOW_EPOCHS);
+    return total > 0 ? MyElement_init(key, total) : MyElement_getEmptyValue();
+}
@@ -0,0 +1,38 @@
+#ifndef WINDOWEDHASHTABLE_H
+#define WINDOWEDHASHTABLE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "my_element.h"
+#include "atomic_update.h"
+
+#define WINDOW_EPOCHS 8  // Ring length: the longest window that can be queried, in epochs
+#define WINDOW_DEFAULT_LOG_SIZE 20  // 1M slots, 168 MB; 2^24 slots would take 2.8 GB
+
+// Counts kept per epoch in a ring of WINDOW_EPOCHS cells. Each cell packs
+// (epoch << 32) | count, so a cell left over from an expired epoch is simply
+// read as zero and reset by the next write; nothing is ever subtracted.
+// Counts saturate at UINT32_MAX per epoch rather than wrap into the tag.
+// Keys stay in the table once inserted, like in HashTable.
+typedef struct {
+    uint32_t state;  // Slot state, see windowed_hashtable.c
+    char key[MAX_KEY_LENGTH];
+    uint64_t cells[WINDOW_EPOCHS];
+} WindowSlot;
+
+typedef struct {
+    WindowSlot *table;
+    size_t mask;
+    size_t size;
+    uint32_t epoch;  // Current epoch, only ever incremented
+} WindowedHashTable;
+
+WindowedHashTable *WindowedHashTable_init(size_t logSize);
+void WindowedHashTable_free(WindowedHashTable *ht);
+uint32_t WindowedHashTable_advanceEpoch(WindowedHashTable *ht);
+bool WindowedHashTable_insertOrUpdateIncrement(WindowedHashTable *ht, const MyElement *e, Increment f);
+long long WindowedHashTable_findWindow(WindowedHashTable *ht, const char *key, uint32_t epochs);
+MyElement WindowedHashTable_find(WindowedHashTable *ht, const char *key);
+
+#endif // WINDOWEDHASHTABLE_H
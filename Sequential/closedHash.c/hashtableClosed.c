@@ -1,24 +1,48 @@
+#define _POSIX_C_SOURCE 200809L // For strdup and read under -std=c11
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <time.h>
-
-#define HASH_TABLE_SIZE 16777216 // 2^24
+#include <fcntl.h>
+#include <unistd.h>
+
+#define INITIAL_TABLE_SIZE 1024 // Buckets to start with, always a power of two
+#define MAX_LOAD_FACTOR 1       // Grow once there are more nodes than buckets
+#define REHASH_STEP 4           // Old buckets migrated by every insert and erase
+#define MAX_READER_THREADS 64   // Threads that may be inside find at the same time
+#define RETIRE_BATCH 1024       // Retired allocations per batch handed to the reclaimer
+#define RECLAIM_INTERVAL_MS 10  // How often the reclaimer thread frees what is due
 #define MAX_WORD_LENGTH 50      // Maximum word length
 #define NUM_THREADS 16    // Number of threads
+#define STREAM_CHUNK_SIZE (1 << 20)
+#define TOKEN_DELIMITERS " ,.-\n"
 
 // Node structure for hash table
 struct Node {
     char *key;
     int value;
+    unsigned long hash;  // Full hash, so migration never rehashes the key
     struct Node *next;
 };
 
-// Hash table structure
-struct HashTable {
+// One bucket array. While a resize drains it, buckets below migrated have
+// already been relinked into the newer array, and moving is the bucket being
+// relinked right now (-1 if none).
+struct Buckets {
     int size;
-    struct Node **table;
+    int migrated;
+    int moving;
+    struct Node **slots;
+};
+
+// Hash table structure. insert and erase serialise on lock, find takes no
+// lock and runs alongside them. While growing, nodes live in two arrays.
+struct HashTable {
+    struct Buckets *current;
+    struct Buckets *old;  // NULL when no resize is in progress
+    long count;
 };
 
 // Thread data structure
@@ -27,70 +51,384 @@ struct ThreadData {
     int wordCount;
 };
 
+// Epoch-based reclamation. find announces the global epoch in its record
+// while it walks a chain. Writers never free an unlinked node or array
+// directly, they retire it: whatever is retired in epoch e is freed once the
+// global epoch reaches e + 2, and the epoch cannot pass e + 1 while a reader
+// that announced e is still inside find. Advancing the epoch and freeing is
+// left to a reclaimer thread, so insert and erase only append to a list.
+struct EpochRecord {
+    unsigned long state;  // (epoch << 1) | 1 inside find, 0 outside
+    int inUse;
+} __attribute__((aligned(64)));  // One cache line per reader
+
+struct Retired {
+    void *ptr;
+    void (*destroy)(void *);
+    unsigned long epoch;
+};
+
+struct RetireBatch {
+    struct Retired items[RETIRE_BATCH];
+    size_t count;
+    struct RetireBatch *next;
+};
+
 // Global variables
 struct HashTable hashTable;
 pthread_mutex_t lock;
+unsigned long globalEpoch = 0;
+struct EpochRecord epochRecords[MAX_READER_THREADS];
+__thread struct EpochRecord *myEpochRecord = NULL;
+struct RetireBatch *retiredBatches = NULL;  // Newest first, only touched with lock held
+pthread_t reclaimer;
+pthread_mutex_t reclaimLock = PTHREAD_MUTEX_INITIALIZER;  // Guards reclaimerStop
+pthread_cond_t reclaimWake = PTHREAD_COND_INITIALIZER;
+int reclaimerStop = 0;
 
 // Function declarations
 void createHashTable(struct HashTable *hashTable, int size);
+void rehashStep(struct HashTable *hashTable);
 void insert(struct HashTable *hashTable, const char *key);
-struct Node *find(struct HashTable *hashTable, const char *key);
+int erase(struct HashTable *hashTable, const char *key);
+int find(struct HashTable *hashTable, const char *key);
 void destroyHashTable(struct HashTable *hashTable);
 
-// Hash function
-int hashFunction(const char *key, int size) {
+// Hash function, reduced to a bucket with hash & (size - 1)
+unsigned long hashFunction(const char *key) {
     unsigned long hash = 5381;
     int c;
     while ((c = *key++)) {
         hash = ((hash << 5) + hash) + c;
     }
-    return hash % size;
+    return hash;
+}
+
+// Claim an epoch record for the calling thread on its first find
+struct EpochRecord *epochRecord(void) {
+    if (myEpochRecord) return myEpochRecord;
+
+    for (int i = 0; i < MAX_READER_THREADS; i++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&epochRecords[i].inUse, &expected, 1, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            myEpochRecord = &epochRecords[i];
+            return myEpochRecord;
+        }
+    }
+    fprintf(stderr, "More than %d threads calling find\n", MAX_READER_THREADS);
+    exit(1);
+}
+
+// Give the record back, for threads that called find and are about to exit
+void epochUnregister(void) {
+    if (!myEpochRecord) return;
+    __atomic_store_n(&myEpochRecord->inUse, 0, __ATOMIC_RELEASE);
+    myEpochRecord = NULL;
+}
+
+// The only cost a reader pays: one store to its own cache line and a fence
+void epochEnter(void) {
+    struct EpochRecord *record = epochRecord();
+    unsigned long epoch = __atomic_load_n(&globalEpoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&record->state, (epoch << 1) | 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epochExit(void) {
+    __atomic_store_n(&myEpochRecord->state, 0, __ATOMIC_RELEASE);
+}
+
+// Move to the next epoch if every reader inside find has seen the current one.
+// Only the reclaimer thread calls this, so advances never race each other.
+void epochTryAdvance(void) {
+    unsigned long epoch = __atomic_load_n(&globalEpoch, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int i = 0; i < MAX_READER_THREADS; i++) {
+        unsigned long state = __atomic_load_n(&epochRecords[i].state, __ATOMIC_ACQUIRE);
+        if ((state & 1) && (state >> 1) != epoch) return;
+    }
+    __atomic_store_n(&globalEpoch, epoch + 1, __ATOMIC_RELEASE);
+}
+
+// Free what is due in the batches and drop batches that end up empty. With
+// force, everything is freed: for teardown, when no reader is left.
+struct RetireBatch *epochReclaim(struct RetireBatch *batches, int force) {
+    unsigned long epoch = __atomic_load_n(&globalEpoch, __ATOMIC_ACQUIRE);
+    struct RetireBatch **link = &batches;
+    while (*link) {
+        struct RetireBatch *batch = *link;
+        size_t kept = 0;
+        for (size_t i = 0; i < batch->count; i++) {
+            if (force || batch->items[i].epoch + 2 <= epoch) {
+                batch->items[i].destroy(batch->items[i].ptr);
+            } else {
+                batch->items[kept++] = batch->items[i];
+            }
+        }
+        batch->count = kept;
+        if (kept == 0) {
+            *link = batch->next;
+            free(batch);
+        } else {
+            link = &batch->next;
+        }
+    }
+    return batches;
 }
 
-// Create the hash table
+// Hand an unlinked allocation over for freeing once no reader can reach it.
+// Called with lock held; costs an append, the freeing happens in the reclaimer.
+void retire(void *ptr, void (*destroy)(void *)) {
+    if (!retiredBatches || retiredBatches->count == RETIRE_BATCH) {
+        struct RetireBatch *batch = malloc(sizeof(struct RetireBatch));
+        if (!batch) return; // Out of memory: leak it, a reader may still hold it
+        batch->count = 0;
+        batch->next = retiredBatches;
+        retiredBatches = batch;
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // The epoch is read after ptr was unlinked
+    retiredBatches->items[retiredBatches->count++] =
+        (struct Retired){ptr, destroy, __atomic_load_n(&globalEpoch, __ATOMIC_RELAXED)};
+}
+
+// Every RECLAIM_INTERVAL_MS: take the writers' batches (the only moment it
+// holds lock, for a pointer swap), advance the epoch and free what is due.
+// Returns what is still pending when stopped.
+void *reclaimerLoop(void *arg) {
+    (void)arg;
+    struct RetireBatch *pending = NULL;
+
+    pthread_mutex_lock(&reclaimLock);
+    while (!reclaimerStop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += RECLAIM_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&reclaimWake, &reclaimLock, &deadline);
+        pthread_mutex_unlock(&reclaimLock);
+
+        pthread_mutex_lock(&lock);
+        struct RetireBatch *taken = retiredBatches;
+        retiredBatches = NULL;
+        pthread_mutex_unlock(&lock);
+
+        while (taken) {
+            struct RetireBatch *next = taken->next;
+            taken->next = pending;
+            pending = taken;
+            taken = next;
+        }
+        epochTryAdvance();
+        pending = epochReclaim(pending, 0);
+
+        pthread_mutex_lock(&reclaimLock);
+    }
+    pthread_mutex_unlock(&reclaimLock);
+    return pending;
+}
+
+void startReclaimer(void) {
+    reclaimerStop = 0;
+    pthread_create(&reclaimer, NULL, reclaimerLoop, NULL);
+}
+
+// Stop the reclaimer and return what it had not freed yet
+struct RetireBatch *stopReclaimer(void) {
+    pthread_mutex_lock(&reclaimLock);
+    reclaimerStop = 1;
+    pthread_cond_signal(&reclaimWake);
+    pthread_mutex_unlock(&reclaimLock);
+
+    void *pending;
+    pthread_join(reclaimer, &pending);
+    return pending;
+}
+
+void freeNode(void *ptr) {
+    struct Node *node = ptr;
+    free(node->key);
+    free(node);
+}
+
+void freeBuckets(void *ptr) {
+    struct Buckets *buckets = ptr;
+    free(buckets->slots);
+    free(buckets);
+}
+
+struct Buckets *createBuckets(int size) {
+    struct Buckets *buckets = malloc(sizeof(struct Buckets));
+    if (!buckets) return NULL;
+    buckets->size = size;
+    buckets->migrated = 0;
+    buckets->moving = -1;
+    buckets->slots = calloc(size, sizeof(struct Node *));
+    if (!buckets->slots) {
+        free(buckets);
+        return NULL;
+    }
+    return buckets;
+}
+
+// Create the hash table and start its reclaimer
 void createHashTable(struct HashTable *hashTable, int size) {
-    hashTable->size = size;
-    hashTable->table = calloc(size, sizeof(struct Node *));
+    hashTable->current = createBuckets(size);
+    hashTable->old = NULL;
+    hashTable->count = 0;
+    startReclaimer();
 }
 
-// Insert into the hash table
-void insert(struct HashTable *hashTable, const char *key) {
+// Start growing: the current array becomes the old one and is drained
+// REHASH_STEP buckets at a time, so no single call pays for the whole resize
+void startRehash(struct HashTable *hashTable) {
+    struct Buckets *bigger = createBuckets(hashTable->current->size * 2);
+    if (!bigger) return; // Keep the current size, chains just get longer
+
+    // old is published before current, so a reader that sees the new array
+    // also sees the old one it has to fall back to
+    __atomic_store_n(&hashTable->old, hashTable->current, __ATOMIC_RELEASE);
+    __atomic_store_n(&hashTable->current, bigger, __ATOMIC_RELEASE);
+}
+
+// Relink the next REHASH_STEP old buckets into the new array. A find walking
+// an old chain meanwhile may be led into a new one and miss its key; it
+// notices through moving and migrated (see bucketMoved) and looks again.
+void rehashStep(struct HashTable *hashTable) {
+    struct Buckets *old = hashTable->old;
+    if (!old) return;
+    struct Buckets *current = hashTable->current;
+
+    for (int step = 0; step < REHASH_STEP && old->migrated < old->size; step++) {
+        __atomic_store_n(&old->moving, old->migrated, __ATOMIC_SEQ_CST); // Before any next pointer changes
+        struct Node *node = old->slots[old->migrated];
+        while (node) {
+            struct Node *next = node->next;
+            struct Node **slot = &current->slots[node->hash & (current->size - 1)];
+            __atomic_store_n(&node->next, *slot, __ATOMIC_RELEASE);
+            __atomic_store_n(slot, node, __ATOMIC_RELEASE);
+            node = next;
+        }
+        __atomic_store_n(&old->migrated, old->migrated + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&old->moving, -1, __ATOMIC_RELEASE);
+    }
+
+    if (old->migrated == old->size) {
+        __atomic_store_n(&hashTable->old, NULL, __ATOMIC_RELEASE);
+        retire(old, freeBuckets);
+    }
+}
+
+// Chain that holds hash right now: the old bucket if it has not moved yet.
+// current is read before old, see startRehash. If from is not NULL, it is
+// set to the array the chain belongs to.
+struct Node **bucketFor(struct HashTable *hashTable, unsigned long hash, struct Buckets **from) {
+    struct Buckets *current = __atomic_load_n(&hashTable->current, __ATOMIC_ACQUIRE);
+    struct Buckets *old = __atomic_load_n(&hashTable->old, __ATOMIC_ACQUIRE);
+    struct Buckets *buckets = current;
+    if (old && old != current && (int)(hash & (old->size - 1)) >= __atomic_load_n(&old->migrated, __ATOMIC_ACQUIRE)) {
+        buckets = old;
+    }
+    if (from) *from = buckets;
+    return &buckets->slots[hash & (buckets->size - 1)];
+}
+
+// Whether bucket index of buckets was relinked, or is being relinked, since a
+// find started walking it; the array may have become the old one meanwhile.
+// Having followed a relinked pointer, the reader reads moving == index, or
+// the -1 stored after migrated was raised past index.
+int bucketMoved(struct Buckets *buckets, int index) {
+    return __atomic_load_n(&buckets->moving, __ATOMIC_ACQUIRE) == index ||
+           __atomic_load_n(&buckets->migrated, __ATOMIC_ACQUIRE) > index;
+}
+
+// Insert into the hash table, hash = hashFunction(key)
+void insertHashed(struct HashTable *hashTable, const char *key, unsigned long hash) {
     pthread_mutex_lock(&lock);
-    int index = hashFunction(key, hashTable->size);
+    rehashStep(hashTable);
+    struct Node **bucket = bucketFor(hashTable, hash, NULL);
 
     // Check if the word already exists
-    struct Node *current = hashTable->table[index];
+    struct Node *current = *bucket;
     while (current != NULL) {
-        if (strcmp(current->key, key) == 0) {
-            current->value++;
+        if (current->hash == hash && strcmp(current->key, key) == 0) {
+            __atomic_fetch_add(&current->value, 1, __ATOMIC_RELAXED);
             pthread_mutex_unlock(&lock);
             return;
         }
         current = current->next;
     }
 
-    // Add a new node
+    // Add a new node to the same chain, so a key is only ever in the bucket
+    // bucketFor picks; an old bucket takes its new keys along when it moves
     struct Node *newNode = malloc(sizeof(struct Node));
     newNode->key = strdup(key);
     newNode->value = 1;
-    newNode->next = hashTable->table[index];
-    hashTable->table[index] = newNode;
+    newNode->hash = hash;
+    newNode->next = *bucket;
+    __atomic_store_n(bucket, newNode, __ATOMIC_RELEASE); // Publish the filled node
+    hashTable->count++;
+
+    if (!hashTable->old && hashTable->count > (long)hashTable->current->size * MAX_LOAD_FACTOR) {
+        startRehash(hashTable);
+    }
 
     pthread_mutex_unlock(&lock);
 }
 
-// Destroy the hash table
-void destroyHashTable(struct HashTable *hashTable) {
-    for (int i = 0; i < hashTable->size; i++) {
-        struct Node *current = hashTable->table[i];
+void insert(struct HashTable *hashTable, const char *key) {
+    insertHashed(hashTable, key, hashFunction(key));
+}
+
+// Remove a key, returns 1 if it was present. The node is unlinked and
+// retired, a concurrent find may still be reading it.
+int erase(struct HashTable *hashTable, const char *key) {
+    pthread_mutex_lock(&lock);
+    rehashStep(hashTable);
+    unsigned long hash = hashFunction(key);
+    struct Node **link = bucketFor(hashTable, hash, NULL);
+
+    for (struct Node *current = *link; current != NULL; link = &current->next, current = *link) {
+        if (current->hash == hash && strcmp(current->key, key) == 0) {
+            __atomic_store_n(link, current->next, __ATOMIC_RELEASE);
+            hashTable->count--;
+            retire(current, freeNode);
+            pthread_mutex_unlock(&lock);
+            return 1;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+void destroyChains(struct Node **slots, int from, int size) {
+    for (int i = from; i < size; i++) {
+        struct Node *current = slots[i];
         while (current) {
             struct Node *temp = current;
             current = current->next;
-            free(temp->key);
-            free(temp);
+            freeNode(temp);
         }
     }
-    free(hashTable->table);
+}
+
+// Destroy the hash table. No other thread may use it any more, so whatever
+// is still retired is freed regardless of its epoch.
+void destroyHashTable(struct HashTable *hashTable) {
+    epochReclaim(stopReclaimer(), 1);
+    epochReclaim(retiredBatches, 1);
+    retiredBatches = NULL;
+
+    destroyChains(hashTable->current->slots, 0, hashTable->current->size);
+    freeBuckets(hashTable->current);
+    if (hashTable->old) {
+        // Migrated buckets point into the new array's chains, skip them
+        destroyChains(hashTable->old->slots, hashTable->old->migrated, hashTable->old->size);
+        freeBuckets(hashTable->old);
+    }
 }
 
 // Thread function
@@ -103,28 +441,180 @@ void *processWords(void *arg) {
     return NULL;
 }
 
-struct Node *find(struct HashTable *hashTable, const char *key) {
-    int index = hashFunction(key, hashTable->size); // Get the hash index
-    struct Node *current = hashTable->table[index];
+// Lock-free lookup, safe alongside insert and erase. Returns the count of
+// key, 0 if it is not in the table.
+int find(struct HashTable *hashTable, const char *key) {
+    unsigned long hash = hashFunction(key);
+    int value = 0;
+
+    epochEnter();
+    while (1) {
+        struct Buckets *from;
+        struct Node *current = __atomic_load_n(bucketFor(hashTable, hash, &from), __ATOMIC_ACQUIRE);
+
+        // Traverse the linked list at the given index
+        while (current != NULL) {
+            if (current->hash == hash && strcmp(current->key, key) == 0) {
+                value = __atomic_load_n(&current->value, __ATOMIC_RELAXED);
+                break;
+            }
+            current = __atomic_load_n(&current->next, __ATOMIC_ACQUIRE);
+        }
+        // A miss in a bucket that moved meanwhile proves nothing, look again
+        if (current || !bucketMoved(from, hash & (from->size - 1))) break;
+    }
+    epochExit();
+    return value;
+}
 
-    // Traverse the linked list at the given index
-    while (current != NULL) {
-        if (strcmp(current->key, key) == 0) {
-            return current; // Return the node if the key matches
+// Chunked reader for --stream, one chunk plus a carried partial token
+struct StreamReader {
+    int fd;
+    char *buffer;       // STREAM_CHUNK_SIZE + 1 bytes
+    size_t tail;        // Start of the partial token carried into the next chunk
+    size_t tailLength;
+    int eof;
+};
+
+struct StreamReader *streamOpen(const char *path) {
+    struct StreamReader *r = malloc(sizeof(struct StreamReader));
+    r->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    r->buffer = malloc(STREAM_CHUNK_SIZE + 1);
+    r->tail = 0;
+    r->tailLength = 0;
+    r->eof = 0;
+    if (r->fd < 0) {
+        perror("Could not open stream");
+        free(r->buffer);
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+void streamClose(struct StreamReader *r) {
+    if (r->fd != STDIN_FILENO) close(r->fd);
+    free(r->buffer);
+    free(r);
+}
+
+// Next NUL-terminated chunk cut at the last delimiter, NULL at end of input.
+// read() hands over what a pipe has, so lines are processed as they arrive.
+char *streamNext(struct StreamReader *r) {
+    memmove(r->buffer, r->buffer + r->tail, r->tailLength);
+    size_t filled = r->tailLength;
+    r->tail = 0;
+    r->tailLength = 0;
+
+    while (!r->eof && filled < STREAM_CHUNK_SIZE) {
+        ssize_t n = read(r->fd, r->buffer + filled, STREAM_CHUNK_SIZE - filled);
+        if (n <= 0) {
+            r->eof = 1;
+            break;
         }
-        current = current->next;
+        filled += n;
+        if (memchr(r->buffer + filled - n, '\n', n)) break; // A complete line arrived
     }
-    return NULL; // Key not found
+    if (filled == 0) return NULL;
+
+    size_t cut = filled;
+    if (!r->eof) {
+        while (cut > 0 && !strchr(TOKEN_DELIMITERS, r->buffer[cut - 1])) cut--;
+        if (cut == 0) cut = filled; // One token fills the whole chunk
+    }
+    r->tail = cut;
+    r->tailLength = filled - cut;
+    r->buffer[cut == filled ? filled : cut - 1] = '\0'; // Overwrites a delimiter, never the tail
+    return r->buffer;
 }
 
+// TOKEN_DELIMITERS spelled out, cheaper than a strchr per byte
+static inline int isDelimiter(char c) {
+    return c == ' ' || c == ',' || c == '.' || c == '-' || c == '\n';
+}
 
-int main() {
+// Next token of a NUL-terminated chunk, hashed while it is scanned so the
+// insert does not walk it again; the delimiter after it is overwritten.
+// Returns NULL at the end of the chunk.
+char *nextToken(char **cursor, unsigned long *hash) {
+    char *p = *cursor;
+    while (isDelimiter(*p)) p++;
+    if (*p == '\0') return NULL;
+
+    char *token = p;
+    unsigned long h = 5381;
+    for (; *p && !isDelimiter(*p); p++) {
+        h = ((h << 5) + h) + *p;  // Same steps as hashFunction
+    }
+    if (*p) *p++ = '\0';
+    *cursor = p;
+    *hash = h;
+    return token;
+}
+
+// Streaming mode: tokenize and insert chunk by chunk, memory stays at one
+// chunk plus the table however long the input is
+long long streamInsert(struct HashTable *hashTable, const char *path) {
+    struct StreamReader *reader = streamOpen(path);
+    if (!reader) return -1;
+
+    long long totalWords = 0;
+    char *chunk;
+    while ((chunk = streamNext(reader)) != NULL) {
+        unsigned long hash;
+        for (char *token = nextToken(&chunk, &hash); token != NULL; token = nextToken(&chunk, &hash)) {
+            insertHashed(hashTable, token, hash);
+            totalWords++;
+        }
+    }
+
+    streamClose(reader);
+    return totalWords;
+}
+
+// Run the --find and --erase arguments against the filled table, in order
+void runQueries(struct HashTable *hashTable, int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--find") == 0) {
+            printf("Word '%s' appears %d times.\n", argv[i + 1], find(hashTable, argv[i + 1]));
+            i++;
+        } else if (strcmp(argv[i], "--erase") == 0) {
+            printf(erase(hashTable, argv[i + 1]) ? "Erased '%s'.\n" : "Word '%s' not found.\n", argv[i + 1]);
+            i++;
+        }
+    }
+}
+
+// Usage: hashtableClosed [--stream [file|-]] [--find word | --erase word ...]
+// --find and --erase run in the order given, once every word is inserted.
+int main(int argc, char *argv[]) {
     pthread_mutex_init(&lock, NULL);
 
     // Measure time
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
+    // Streaming mode: hashtableClosed --stream [file|-]
+    if (argc > 1 && strcmp(argv[1], "--stream") == 0) {
+        const char *path = argc > 2 && strncmp(argv[2], "--", 2) != 0 ? argv[2] : "-";
+        createHashTable(&hashTable, INITIAL_TABLE_SIZE);
+        long long streamed = streamInsert(&hashTable, path);
+        if (streamed >= 0) {
+            runQueries(&hashTable, argc, argv);
+        }
+        destroyHashTable(&hashTable);
+        pthread_mutex_destroy(&lock);
+        if (streamed < 0) {
+            return 1;
+        }
+        printf("Total words streamed: %lld\n", streamed);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("Program execution time: %.6f seconds\n", elapsed);
+        return 0;
+    }
+
 // Step 1: Read the file 10 times
 FILE *file;
 char **words = malloc(10000000 * sizeof(char *)); // Allocate space for 10 million words
@@ -172,7 +662,7 @@ printf("Total words read: %d\n", totalWords);
 
 
     // Step 2: Initialize hash table
-    createHashTable(&hashTable, HASH_TABLE_SIZE);
+    createHashTable(&hashTable, INITIAL_TABLE_SIZE);
 
     // Step 3: Split words among threads
     pthread_t threads[NUM_THREADS];
@@ -201,14 +691,8 @@ printf("Total words read: %d\n", totalWords);
         pthread_join(threads[i], NULL);
     }
 
-    // Step 5: Find a word
-    /* struct Node *result = find(&hashTable, "Lorem");
-    if (result) {
-        printf("Word 'Lorem' appears %d times.\n", result->value);
-    } else {
-        printf("Word 'Lorem' not found.\n");
-    }
-    */
+    // Step 5: Find or erase words given on the command line
+    runQueries(&hashTable, argc, argv);
 
     // Step 6: Cleanup
     for (int i = 0; i < totalWords; i++) {
@@ -1,12 +1,20 @@
+#define _POSIX_C_SOURCE 200809L // For strdup and read under -std=c11
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define HASH_TABLE_SIZE 16777216 // Larger size for ~10 million words
+#define AUTO_INITIAL_SIZE 1024   // --auto-size: first table size, doubled as keys arrive
+#define AUTO_MAX_LOAD 0.5        // --auto-size: grow before more than this share of slots is used
 #define MAX_WORD_LENGTH 50       // Maximum word length
 #define NUM_THREADS 1  // Number of threads
+#define STREAM_CHUNK_SIZE (1 << 20)
+#define TOKEN_DELIMITERS " ,.-\n"
 
 // Node structure for open addressing
 struct Node {
@@ -19,6 +27,8 @@ struct Node {
 struct HashTable {
     struct Node** table;
     int size;
+    int used;   // Slots holding a node, deleted or not
+    int grow;   // Double the table at AUTO_MAX_LOAD instead of staying at size
 };
 
 pthread_mutex_t lock;
@@ -29,37 +39,78 @@ void insert(struct HashTable* hashtable, const char* key, int value);
 struct Node* search(struct HashTable* hashtable, const char* key);
 void destroyHashTable(struct HashTable* hashtable);
 
-// Hash function
-int hashFunction(const char* key, int size) {
+// Hash function, before reduction to a slot
+unsigned long hashString(const char* key) {
     unsigned long hash = 5381;
     int c;
     while ((c = *key++)) {
         hash = ((hash << 5) + hash) + c;
     }
-    return hash % size;
+    return hash;
+}
+
+int hashFunction(const char* key, int size) {
+    return hashString(key) % size;
 }
 
 // Create the hash table
 struct HashTable* createHashTable(int size) {
     struct HashTable* hashtable = (struct HashTable*)malloc(sizeof(struct HashTable));
     hashtable->size = size;
+    hashtable->used = 0;
+    hashtable->grow = 0;
     hashtable->table = (struct Node**)calloc(size, sizeof(struct Node*));
     return hashtable;
 }
 
-// Insert into the hash table (open addressing)
-void insert(struct HashTable* hashtable, const char* key, int value) {
-    int index = hashFunction(key, hashtable->size);
+// Double the table and re-place every live node, dropping deleted ones.
+// Called with the lock held.
+void growHashTable(struct HashTable* hashtable) {
+    struct Node** old = hashtable->table;
+    int oldSize = hashtable->size;
+    struct Node** table = (struct Node**)calloc(oldSize * 2, sizeof(struct Node*));
+    if (!table) return; // Keep probing the full table, as without --auto-size
+
+    hashtable->table = table;
+    hashtable->size = oldSize * 2;
+    hashtable->used = 0;
+    for (int i = 0; i < oldSize; i++) {
+        struct Node* node = old[i];
+        if (node == NULL) continue;
+        if (node->deleted) {
+            free(node->key);
+            free(node);
+            continue;
+        }
+        int index = hashFunction(node->key, hashtable->size);
+        while (table[index] != NULL) {
+            index = (index + 1) % hashtable->size;
+        }
+        table[index] = node;
+        hashtable->used++;
+    }
+    free(old);
+}
+
+// Insert into the hash table (open addressing). The lock is held for the
+// whole probe, so a resize cannot move the slots from under it. hash is the
+// unreduced hash of key, taken modulo the size current under the lock.
+void insertHashed(struct HashTable* hashtable, const char* key, unsigned long hash, int value) {
+    pthread_mutex_lock(&lock);
+    if (hashtable->grow && hashtable->used + 1 > hashtable->size * AUTO_MAX_LOAD) {
+        growHashTable(hashtable);
+    }
+
+    int index = hash % hashtable->size;
     int originalIndex = index;
 
     for (int i = 0; i < hashtable->size; i++) {
-        pthread_mutex_lock(&lock);
-
         if (hashtable->table[index] == NULL || hashtable->table[index]->deleted) {
             struct Node* newNode = malloc(sizeof(struct Node));
             newNode->key = strdup(key);
             newNode->value = value;
             newNode->deleted = 0;
+            if (hashtable->table[index] == NULL) hashtable->used++;
             hashtable->table[index] = newNode;
             pthread_mutex_unlock(&lock);
             return;
@@ -71,9 +122,13 @@ void insert(struct HashTable* hashtable, const char* key, int value) {
             return;
         }
 
-        pthread_mutex_unlock(&lock);
         index = (originalIndex + i) % hashtable->size; // Linear probing
     }
+    pthread_mutex_unlock(&lock);
+}
+
+void insert(struct HashTable* hashtable, const char* key, int value) {
+    insertHashed(hashtable, key, hashString(key), value);
 }
 
 // Destroy the hash table
@@ -105,13 +160,159 @@ void* processWords(void* arg) {
     return NULL;
 }
 
-int main() {
+// Chunked reader for --stream, one chunk plus a carried partial token
+struct StreamReader {
+    int fd;
+    char *buffer;       // STREAM_CHUNK_SIZE + 1 bytes
+    size_t tail;        // Start of the partial token carried into the next chunk
+    size_t tailLength;
+    int eof;
+};
+
+struct StreamReader *streamOpen(const char *path) {
+    struct StreamReader *r = malloc(sizeof(struct StreamReader));
+    r->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    r->buffer = malloc(STREAM_CHUNK_SIZE + 1);
+    r->tail = 0;
+    r->tailLength = 0;
+    r->eof = 0;
+    if (r->fd < 0) {
+        perror("Could not open stream");
+        free(r->buffer);
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+void streamClose(struct StreamReader *r) {
+    if (r->fd != STDIN_FILENO) close(r->fd);
+    free(r->buffer);
+    free(r);
+}
+
+// Next NUL-terminated chunk cut at the last delimiter, NULL at end of input.
+// read() hands over what a pipe has, so lines are processed as they arrive.
+char *streamNext(struct StreamReader *r) {
+    memmove(r->buffer, r->buffer + r->tail, r->tailLength);
+    size_t filled = r->tailLength;
+    r->tail = 0;
+    r->tailLength = 0;
+
+    while (!r->eof && filled < STREAM_CHUNK_SIZE) {
+        ssize_t n = read(r->fd, r->buffer + filled, STREAM_CHUNK_SIZE - filled);
+        if (n <= 0) {
+            r->eof = 1;
+            break;
+        }
+        filled += n;
+        if (memchr(r->buffer + filled - n, '\n', n)) break; // A complete line arrived
+    }
+    if (filled == 0) return NULL;
+
+    size_t cut = filled;
+    if (!r->eof) {
+        while (cut > 0 && !strchr(TOKEN_DELIMITERS, r->buffer[cut - 1])) cut--;
+        if (cut == 0) cut = filled; // One token fills the whole chunk
+    }
+    r->tail = cut;
+    r->tailLength = filled - cut;
+    r->buffer[cut == filled ? filled : cut - 1] = '\0'; // Overwrites a delimiter, never the tail
+    return r->buffer;
+}
+
+// TOKEN_DELIMITERS spelled out, cheaper than a strchr per byte
+static inline int isDelimiter(char c) {
+    return c == ' ' || c == ',' || c == '.' || c == '-' || c == '\n';
+}
+
+// Next token of a NUL-terminated chunk, hashed while it is scanned so the
+// insert does not walk it again; the delimiter after it is overwritten.
+// Returns NULL at the end of the chunk.
+char *nextToken(char **cursor, unsigned long *hash) {
+    char *p = *cursor;
+    while (isDelimiter(*p)) p++;
+    if (*p == '\0') return NULL;
+
+    char *token = p;
+    unsigned long h = 5381;
+    for (; *p && !isDelimiter(*p); p++) {
+        h = ((h << 5) + h) + *p;  // Same steps as hashString
+    }
+    if (*p) *p++ = '\0';
+    *cursor = p;
+    *hash = h;
+    return token;
+}
+
+// Streaming mode: tokenize and insert chunk by chunk, memory stays at one
+// chunk plus the table however long the input is
+long long streamInsert(struct HashTable *hashtable, const char *path) {
+    struct StreamReader *reader = streamOpen(path);
+    if (!reader) return -1;
+
+    long long totalWords = 0;
+    char *chunk;
+    while ((chunk = streamNext(reader)) != NULL) {
+        unsigned long hash;
+        for (char *token = nextToken(&chunk, &hash); token != NULL; token = nextToken(&chunk, &hash)) {
+            insertHashed(hashtable, token, hash, 1);
+            totalWords++;
+        }
+    }
+
+    streamClose(reader);
+    return totalWords;
+}
+
+// Table for the run: HASH_TABLE_SIZE slots, or with --auto-size a small table
+// that grows with the keys it is given. The number of distinct keys is not
+// known before they are inserted, and nodes are pointers, so doubling only
+// moves pointers; that is simpler here than estimating the count up front.
+struct HashTable* createTableFor(int autoSize) {
+    if (!autoSize) return createHashTable(HASH_TABLE_SIZE);
+    struct HashTable* hashtable = createHashTable(AUTO_INITIAL_SIZE);
+    hashtable->grow = 1;
+    return hashtable;
+}
+
+// Usage: hashtableOpen [--auto-size] [--stream [file|-]]
+// --auto-size starts from AUTO_INITIAL_SIZE slots and doubles the table as it fills
+int main(int argc, char *argv[]) {
     pthread_mutex_init(&lock, NULL);
 
     // Measure time
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
 
+    int autoSize = 0;
+    const char* streamPath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--auto-size") == 0) {
+            autoSize = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streamPath = i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 ? argv[++i] : "-";
+        }
+    }
+
+    // Streaming mode: hashtableOpen --stream [file|-]
+    if (streamPath) {
+        struct HashTable *hashtable = createTableFor(autoSize);
+        long long streamed = streamInsert(hashtable, streamPath);
+        if (autoSize && streamed >= 0) printf("Table grew to %d slots\n", hashtable->size);
+        destroyHashTable(hashtable);
+        pthread_mutex_destroy(&lock);
+        if (streamed < 0) {
+            return 1;
+        }
+        printf("Total words streamed: %lld\n", streamed);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("Program execution time: %.6f seconds\n", elapsed);
+        return 0;
+    }
+
     // Step 1: Read the file 10 times
     FILE* file;
     char** words = malloc(10000000 * sizeof(char*));
@@ -147,7 +348,7 @@ int main() {
     printf("Total words read: %d\n", totalWords);
 
     // Step 2: Create the hash table
-    struct HashTable* hashtable = createHashTable(HASH_TABLE_SIZE);
+    struct HashTable* hashtable = createTableFor(autoSize);
 
     // Step 3: Split words among threads
     pthread_t threads[NUM_THREADS];
@@ -177,6 +378,8 @@ int main() {
         pthread_join(threads[i], NULL);
     }
 
+    if (autoSize) printf("Table grew to %d slots\n", hashtable->size);
+
     // Step 5: Cleanup
     for (int i = 0; i < totalWords; i++) {
         free(words[i]);